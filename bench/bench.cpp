@@ -0,0 +1,249 @@
+// Benchmark harness: generates a contest command stream, replays it
+// through ICPCSystem and reports per-command latency and throughput
+// against the judge's 2 s / 512 MiB budget.
+//
+//   bench [key=value ...]     generate and replay
+//   bench dump [key=value ...] print the generated stream instead
+//   bench file=PATH           replay an existing input file
+//
+// Keys: seed, teams, problems, submissions, accept (fraction Accepted),
+// flush and query (chance per command), rounds (freeze/scroll rounds),
+// freeze (fraction of each round before FREEZE, 1 = never), errors
+// (chance of a command that must fail) and preset=frozen for a fully
+// frozen 10^4-team board.
+//
+// readers=N starts N threads at START that read the published rankings
+// for the rest of the replay, checking each snapshot is a permutation
+// and re-registering often so reader slots get recycled. Latencies then
+// include the cost of publishing under reader load.
+
+#include "icpc_system.h"
+#include "stream_generator.h"
+
+#include <chrono>
+#include <sys/resource.h>
+
+namespace {
+
+struct BenchConfig {
+    StreamConfig stream;
+    string file;
+    bool dump = false;
+    int readers = 0;
+};
+
+bool parseArgs(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i < argc; i++) {
+        string_view arg = argv[i];
+        if (arg == "dump") {
+            config.dump = true;
+            continue;
+        }
+        size_t eq = arg.find('=');
+        if (eq == string_view::npos) return false;
+        string_view key = arg.substr(0, eq);
+        string value(arg.substr(eq + 1));
+        if (key == "file") config.file = value;
+        else if (key == "readers") config.readers = min(max(0, stoi(value)), RankingPublisher::MAX_READERS);
+        else if (!setStreamOption(config.stream, key, value)) return false;
+    }
+    return true;
+}
+
+enum CommandType {
+    ADDTEAM, START, SUBMIT, FLUSH, FREEZE, SCROLL,
+    QUERY_RANKING, QUERY_SUBMISSION, END, COMMAND_TYPES
+};
+
+const char* const COMMAND_NAMES[COMMAND_TYPES] = {
+    "ADDTEAM", "START", "SUBMIT", "FLUSH", "FREEZE", "SCROLL",
+    "QUERY_RANKING", "QUERY_SUBMISSION", "END"
+};
+
+CommandType classify(string_view line) {
+    string_view cmd = nextToken(line);
+    for (int type = 0; type < COMMAND_TYPES; type++) {
+        if (cmd == COMMAND_NAMES[type]) return CommandType(type);
+    }
+    return COMMAND_TYPES;
+}
+
+// Latencies bucketed by power of two nanoseconds
+struct LatencyStats {
+    static const int BUCKETS = 40;
+    uint64_t count = 0;
+    uint64_t totalNanos = 0;
+    uint64_t maxNanos = 0;
+    uint64_t buckets[BUCKETS] = {};
+    
+    void record(uint64_t nanos) {
+        count++;
+        totalNanos += nanos;
+        maxNanos = max(maxNanos, nanos);
+        buckets[min(BUCKETS - 1, 64 - __builtin_clzll(nanos | 1))]++;
+    }
+    
+    // Upper bound of the bucket holding the given quantile
+    uint64_t quantile(double q) const {
+        uint64_t seen = 0, target = (uint64_t)(q * count);
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > target) return 1ull << b;
+        }
+        return maxNanos;
+    }
+};
+
+// Reader threads for readers=N
+class ReaderLoad {
+private:
+    static const int READS_PER_REGISTRATION = 64;
+    atomic<bool> done{false};
+    atomic<uint64_t> reads{0};
+    atomic<uint64_t> registrations{0};
+    atomic<uint64_t> invalid{0};
+    vector<thread> threads;
+    
+    static bool isPermutation(const RankingSnapshot& snapshot) {
+        vector<char> seen(snapshot.teamRank.size());
+        for (int rank : snapshot.teamRank) {
+            if (rank < 0 || rank >= (int)seen.size() || seen[rank]) return false;
+            seen[rank] = true;
+        }
+        return true;
+    }
+    
+    void readLoop(RankingPublisher& publisher) {
+        while (!done.load()) {
+            RankingPublisher::Reader reader = publisher.registerReader();
+            if (!reader) {
+                this_thread::yield();
+                continue;
+            }
+            registrations++;
+            for (int r = 0; r < READS_PER_REGISTRATION && !done.load(); r++) {
+                reader.read([this](const RankingSnapshot& snapshot) {
+                    if (!isPermutation(snapshot)) invalid++;
+                });
+                reads++;
+            }
+        }
+    }
+    
+public:
+    void start(RankingPublisher& publisher, int count) {
+        for (int t = 0; t < count; t++) {
+            threads.emplace_back(&ReaderLoad::readLoop, this, ref(publisher));
+        }
+    }
+    
+    // Must run before the publisher goes away
+    void stop() {
+        done = true;
+        for (thread& t : threads) t.join();
+        threads.clear();
+    }
+    
+    // False if any reader saw a broken snapshot
+    bool report(int count) const {
+        printf("readers: %d threads, %llu reads, %llu registrations, %llu invalid snapshots\n",
+               count, (unsigned long long)reads.load(), (unsigned long long)registrations.load(),
+               (unsigned long long)invalid.load());
+        return invalid.load() == 0;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        fprintf(stderr, "usage: bench [dump] [preset=frozen] [file=PATH] [readers=N] [key=value ...]\n");
+        return 2;
+    }
+    
+    string stream;
+    if (!config.file.empty()) {
+        FILE* in = fopen(config.file.c_str(), "rb");
+        if (!in) {
+            fprintf(stderr, "bench: cannot open %s\n", config.file.c_str());
+            return 1;
+        }
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) stream.append(chunk, n);
+        fclose(in);
+    } else {
+        stream = generateStream(config.stream);
+    }
+    if (config.dump) {
+        fwrite(stream.data(), 1, stream.size(), stdout);
+        return 0;
+    }
+    
+    FILE* sink = fopen("/dev/null", "w");
+    OutputWriter writer(sink);
+    ICPCSystem system(writer);
+    LatencyStats stats[COMMAND_TYPES + 1];
+    ReaderLoad readerLoad;
+    bool readersStarted = false;
+    
+    using Clock = chrono::steady_clock;
+    auto replayStart = Clock::now();
+    string_view rest = stream;
+    uint64_t commands = 0;
+    while (!rest.empty()) {
+        size_t newline = rest.find('\n');
+        string_view line = rest.substr(0, newline);
+        rest.remove_prefix(newline == string_view::npos ? rest.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        
+        CommandType type = classify(line);
+        auto start = Clock::now();
+        bool running = runCommand(system, line);
+        auto stop = Clock::now();
+        stats[type].record(chrono::duration_cast<chrono::nanoseconds>(stop - start).count());
+        commands++;
+        if (type == START && config.readers > 0 && !readersStarted) {
+            readerLoad.start(system.rankingPublisher(), config.readers);
+            readersStarted = true;
+        }
+        if (!running) break;
+    }
+    readerLoad.stop();
+    writer.flush();
+    double seconds = chrono::duration<double>(Clock::now() - replayStart).count();
+    fclose(sink);
+    
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double peakMiB = usage.ru_maxrss / 1024.0;
+    
+    printf("%-17s %9s %10s %9s %9s %9s\n", "command", "count", "total ms", "p50 ns", "p99 ns", "max ns");
+    for (int type = 0; type < COMMAND_TYPES; type++) {
+        const LatencyStats& s = stats[type];
+        if (s.count == 0) continue;
+        printf("%-17s %9llu %10.2f %9llu %9llu %9llu\n", COMMAND_NAMES[type],
+               (unsigned long long)s.count, s.totalNanos / 1e6,
+               (unsigned long long)s.quantile(0.5), (unsigned long long)s.quantile(0.99),
+               (unsigned long long)s.maxNanos);
+    }
+    
+    printf("\nlatency histogram (commands per bucket, bucket = [2^(k-1), 2^k) ns)\n");
+    for (int type = 0; type < COMMAND_TYPES; type++) {
+        const LatencyStats& s = stats[type];
+        if (s.count == 0) continue;
+        printf("%-17s", COMMAND_NAMES[type]);
+        for (int b = 0; b < LatencyStats::BUCKETS; b++) {
+            if (s.buckets[b]) printf(" 2^%d:%llu", b, (unsigned long long)s.buckets[b]);
+        }
+        printf("\n");
+    }
+    
+    printf("\n%llu commands in %.3f s (%.0f commands/s), peak RSS %.1f MiB\n",
+           (unsigned long long)commands, seconds, commands / max(seconds, 1e-9), peakMiB);
+    bool readersOk = !readersStarted || readerLoad.report(config.readers);
+    bool withinBudget = seconds <= 2.0 && peakMiB <= 512.0;
+    printf("budget 2 s / 512 MiB: %s\n", withinBudget ? "ok" : "EXCEEDED");
+    return withinBudget && readersOk ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+// Differential replay: runs every engine over the same command streams,
+// checks that their output is byte-identical to the reference engine and
+// reports wall time and peak RSS per engine as JSON on stdout.
+//
+//   replay_diff [--timeout SECONDS] [--engines NAME,...] [INPUT...]
+//
+// An INPUT is a stored contest log, or gen:key=value,... for a stream
+// built by the bench generator (same keys as bench, e.g.
+// gen:teams=1000,submissions=50000 or gen:preset=frozen). Without any,
+// every bench/logs/*.in is replayed, then DEFAULT_STREAMS.
+//
+// Engines, each run in its own process so RSS is its own:
+//   reference  the original program (bench/reference_engine.h)
+//   serial     ICPCSystem fed one command at a time
+//   batched    ICPCSystem behind BatchingCommandRunner, as main runs it
+//   parallel   batched, with every flush taking the multi-threaded path
+//   restore    batched, snapshotted halfway and resumed in a new system
+//
+// If the reference engine fails or times out, the first engine that
+// finished is the baseline instead. Exits 1 if any engine's output
+// differs or it did not finish.
+
+#include "icpc_system.h"
+#include "reference_engine.h"
+#include "stream_generator.h"
+
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const ENGINE_NAMES[] = {"reference", "serial", "batched", "parallel", "restore"};
+const int ENGINE_COUNT = 5;
+const unsigned PARALLEL_THREADS = 4;
+
+#ifndef REPLAY_DIFF_LOG_DIR
+#define REPLAY_DIFF_LOG_DIR "bench/logs"
+#endif
+
+// Workload shapes the reference engine still finishes in seconds
+const char* const DEFAULT_STREAMS[] = {
+    "gen:teams=50,problems=5,submissions=5000,errors=0.02,rounds=3,flush=0.02,query=0.1",
+    "gen:teams=500,submissions=20000,errors=0.005,rounds=2",
+    "gen:teams=1000,submissions=20000,flush=0,query=0,freeze=0",
+    "gen:seed=9,teams=2000,problems=12,submissions=30000,flush=0.002,errors=0.001",
+};
+
+bool knownEngine(string_view name) {
+    for (const char* engine : ENGINE_NAMES) {
+        if (name == engine) return true;
+    }
+    return false;
+}
+
+uint64_t countLines(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (!in) return 0;
+    InputReader reader(in);
+    string_view line;
+    uint64_t lines = 0;
+    while (reader.nextLine(line)) lines++;
+    fclose(in);
+    return lines;
+}
+
+// Child side: replay inputPath through one engine into outputPath
+int runEngine(string_view engine, const char* inputPath, const char* outputPath) {
+    if (engine == "reference") {
+        ios_base::sync_with_stdio(false);
+        ifstream in(inputPath, ios::binary);
+        ofstream out(outputPath, ios::binary);
+        if (!in || !out) return 1;
+        reference::run(in, out);
+        return out ? 0 : 1;
+    }
+    
+    uint64_t snapshotAt = engine == "restore" ? countLines(inputPath) / 2 : 0;
+    FILE* in = fopen(inputPath, "rb");
+    FILE* outFile = fopen(outputPath, "wb");
+    if (!in || !outFile) return 1;
+    OutputWriter writer(outFile);
+    InputReader reader(in);
+    auto system = make_unique<ICPCSystem>(writer);
+    if (engine == "parallel") system->setParallelFlush(0, PARALLEL_THREADS);
+    auto runner = make_unique<BatchingCommandRunner>(*system);
+    string snapshotPath = string(outputPath) + ".snapshot";
+    
+    string_view line;
+    uint64_t lineCount = 0;
+    while (reader.nextLine(line)) {
+        bool running = engine == "serial" ? runCommand(*system, line) : runner->run(line);
+        if (!running) break;
+        if (++lineCount != snapshotAt) continue;
+        
+        runner->flushSubmits();
+        if (!system->saveSnapshot(snapshotPath.c_str(), lineCount)) return 1;
+        runner.reset();
+        system = make_unique<ICPCSystem>(writer);
+        runner = make_unique<BatchingCommandRunner>(*system);
+        uint64_t restoredLines;
+        bool loaded = system->loadSnapshot(snapshotPath.c_str(), restoredLines);
+        remove(snapshotPath.c_str());
+        if (!loaded || restoredLines != lineCount) return 1;
+    }
+    runner->flushSubmits();
+    writer.flush();
+    return fclose(outFile) == 0 ? 0 : 1;
+}
+
+struct EngineResult {
+    string engine;
+    string status;  // ok, failed, crashed or timeout
+    double seconds = 0;
+    double peakMiB = 0;
+    string output;
+};
+
+// Parent side: re-exec this binary as the engine, so the child's peak
+// RSS is not inflated by pages inherited from the parent
+EngineResult measureEngine(const string& engine, const string& inputPath,
+                           const string& outputPath, int timeoutSeconds) {
+    EngineResult result;
+    result.engine = engine;
+    using Clock = chrono::steady_clock;
+    auto start = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        alarm(timeoutSeconds);
+        execl("/proc/self/exe", "replay_diff", "--run", engine.c_str(),
+              inputPath.c_str(), outputPath.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    int status = 0;
+    rusage usage = {};
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+        result.status = "failed";
+        return result;
+    }
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    result.peakMiB = usage.ru_maxrss / 1024.0;
+    if (WIFSIGNALED(status)) {
+        result.status = WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+    } else {
+        result.status = WEXITSTATUS(status) == 0 ? "ok" : "failed";
+    }
+    
+    ifstream out(outputPath, ios::binary);
+    result.output.assign(istreambuf_iterator<char>(out), istreambuf_iterator<char>());
+    remove(outputPath.c_str());
+    return result;
+}
+
+// 1-based line of the first difference, 0 if the texts are identical
+uint64_t firstDifferentLine(const string& a, const string& b) {
+    size_t common = 0, limit = min(a.size(), b.size());
+    while (common < limit && a[common] == b[common]) common++;
+    if (common == limit && a.size() == b.size()) return 0;
+    return count(a.begin(), a.begin() + common, '\n') + 1;
+}
+
+string jsonString(string_view text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        if ((unsigned char)c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// The stored logs, in name order
+vector<string> storedLogs() {
+    vector<string> logs;
+    DIR* dir = opendir(REPLAY_DIFF_LOG_DIR);
+    if (!dir) return logs;
+    while (dirent* entry = readdir(dir)) {
+        string_view name = entry->d_name;
+        if (name.size() > 3 && name.substr(name.size() - 3) == ".in") {
+            logs.push_back(string(REPLAY_DIFF_LOG_DIR) + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    sort(logs.begin(), logs.end());
+    return logs;
+}
+
+// Materialise an INPUT as a file the engines can read; gen: specs are
+// written to a temporary file, removed afterwards
+bool prepareInput(const string& spec, string& path, bool& temporary) {
+    temporary = false;
+    if (spec.compare(0, 4, "gen:") != 0) {
+        path = spec;
+        return access(path.c_str(), R_OK) == 0;
+    }
+    
+    StreamConfig config;
+    string_view options = string_view(spec).substr(4);
+    while (!options.empty()) {
+        size_t comma = options.find(',');
+        string_view option = options.substr(0, comma);
+        options.remove_prefix(comma == string_view::npos ? options.size() : comma + 1);
+        size_t eq = option.find('=');
+        if (eq == string_view::npos) return false;
+        if (!setStreamOption(config, option.substr(0, eq), string(option.substr(eq + 1)))) return false;
+    }
+    
+    char name[] = "/tmp/replay_diff_input_XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0) return false;
+    string stream = generateStream(config);
+    bool written = write(fd, stream.data(), stream.size()) == (ssize_t)stream.size();
+    close(fd);
+    path = name;
+    temporary = true;
+    return written;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 5 && string_view(argv[1]) == "--run") {
+        return runEngine(argv[2], argv[3], argv[4]);
+    }
+    
+    int timeoutSeconds = 60;
+    vector<string> engines(ENGINE_NAMES, ENGINE_NAMES + ENGINE_COUNT);
+    vector<string> inputs;
+    for (int i = 1; i < argc; i++) {
+        string_view arg = argv[i];
+        if (arg == "--timeout" && i + 1 < argc) {
+            timeoutSeconds = max(1, atoi(argv[++i]));
+        } else if (arg == "--engines" && i + 1 < argc) {
+            engines.clear();
+            string_view list = argv[++i];
+            while (!list.empty()) {
+                size_t comma = list.find(',');
+                engines.emplace_back(list.substr(0, comma));
+                list.remove_prefix(comma == string_view::npos ? list.size() : comma + 1);
+                if (!knownEngine(engines.back())) {
+                    fprintf(stderr, "replay_diff: unknown engine %s\n", engines.back().c_str());
+                    return 2;
+                }
+            }
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    if (engines.empty()) {
+        fprintf(stderr, "usage: replay_diff [--timeout SECONDS] [--engines NAME,...] [INPUT...]\n");
+        return 2;
+    }
+    if (inputs.empty()) {
+        inputs = storedLogs();
+        if (inputs.empty()) fprintf(stderr, "replay_diff: no logs in %s\n", REPLAY_DIFF_LOG_DIR);
+        inputs.insert(inputs.end(), begin(DEFAULT_STREAMS), end(DEFAULT_STREAMS));
+    }
+    
+    char outputName[] = "/tmp/replay_diff_output_XXXXXX";
+    int outputFd = mkstemp(outputName);
+    if (outputFd < 0) {
+        fprintf(stderr, "replay_diff: cannot create a temporary file\n");
+        return 1;
+    }
+    close(outputFd);
+    
+    bool allMatch = true;
+    printf("{\n  \"inputs\": [");
+    for (size_t i = 0; i < inputs.size(); i++) {
+        string path;
+        bool temporary;
+        if (!prepareInput(inputs[i], path, temporary)) {
+            fprintf(stderr, "replay_diff: cannot read input %s\n", inputs[i].c_str());
+            return 1;
+        }
+        
+        vector<EngineResult> results;
+        for (const string& engine : engines) {
+            results.push_back(measureEngine(engine, path, outputName, timeoutSeconds));
+            fprintf(stderr, "%s: %s %s %.3f s\n", inputs[i].c_str(), engine.c_str(),
+                    results.back().status.c_str(), results.back().seconds);
+        }
+        if (temporary) remove(path.c_str());
+        
+        const EngineResult* baseline = nullptr;
+        for (const EngineResult& result : results) {
+            if (result.status == "ok" && (!baseline || result.engine == "reference")) baseline = &result;
+        }
+        
+        const EngineResult* fastest = nullptr;
+        printf("%s\n    {\n      \"input\": %s,\n      \"baseline\": %s,\n      \"engines\": [",
+               i ? "," : "", jsonString(inputs[i]).c_str(),
+               baseline ? jsonString(baseline->engine).c_str() : "null");
+        for (size_t e = 0; e < results.size(); e++) {
+            const EngineResult& result = results[e];
+            uint64_t diffLine = baseline && result.status == "ok"
+                                    ? firstDifferentLine(baseline->output, result.output) : 0;
+            bool matches = baseline && result.status == "ok" && diffLine == 0;
+            allMatch = allMatch && matches;
+            if (matches && (!fastest || result.seconds < fastest->seconds)) fastest = &result;
+            
+            printf("%s\n        {\"engine\": %s, \"status\": %s, \"seconds\": %.6f, "
+                   "\"peak_rss_mib\": %.1f, \"output_bytes\": %zu, \"matches\": %s, "
+                   "\"first_diff_line\": %s}",
+                   e ? "," : "", jsonString(result.engine).c_str(), jsonString(result.status).c_str(),
+                   result.seconds, result.peakMiB, result.output.size(), matches ? "true" : "false",
+                   diffLine ? to_string(diffLine).c_str() : "null");
+        }
+        printf("\n      ],\n      \"fastest_correct\": %s\n    }",
+               fastest ? jsonString(fastest->engine).c_str() : "null");
+    }
+    printf("\n  ],\n  \"all_match\": %s\n}\n", allMatch ? "true" : "false");
+    remove(outputName);
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#ifndef STREAM_GENERATOR_H
+#define STREAM_GENERATOR_H
+
+#include "icpc_system.h"
+
+#include <random>
+
+// Shape of a generated contest command stream
+struct StreamConfig {
+    uint64_t seed = 1;
+    int teams = 10000;
+    int problems = 26;
+    int submissions = 300000;
+    double accept = 0.3;   // Fraction of submissions Accepted
+    double flush = 0.001;  // Chance of a FLUSH after each submission
+    double query = 0.05;   // Chance of a query after each submission
+    int rounds = 1;        // Freeze/scroll rounds
+    double freeze = 0.8;   // Fraction of each round before FREEZE, 1 = never
+    double errors = 0;     // Chance of a command that must fail, per team and per submission
+};
+
+// Apply one key=value option; false if the key or preset is unknown.
+// preset=frozen is a fully frozen 10^4-team board.
+inline bool setStreamOption(StreamConfig& config, string_view key, const string& value) {
+    if (key == "seed") config.seed = stoull(value);
+    else if (key == "teams") config.teams = stoi(value);
+    else if (key == "problems") config.problems = stoi(value);
+    else if (key == "submissions") config.submissions = stoi(value);
+    else if (key == "accept") config.accept = stod(value);
+    else if (key == "flush") config.flush = stod(value);
+    else if (key == "query") config.query = stod(value);
+    else if (key == "rounds") config.rounds = max(1, stoi(value));
+    else if (key == "freeze") config.freeze = stod(value);
+    else if (key == "errors") config.errors = stod(value);
+    else if (key == "preset" && value == "frozen") {
+        config.teams = 10000;
+        config.problems = 26;
+        config.submissions = 300000;
+        config.flush = 0;
+        config.query = 0;
+        config.rounds = 1;
+        config.freeze = 0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// With errors set, the stream also exercises every failure branch:
+// duplicate and late ADDTEAM, a second START, FREEZE while frozen,
+// SCROLL while not, and queries for a team that does not exist. The
+// other commands are drawn exactly as without it.
+inline string generateStream(const StreamConfig& config) {
+    static const char* const NAME_CHARS =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    mt19937_64 rng(config.seed);
+    auto chance = [&rng](double p) {
+        return uniform_real_distribution<double>(0, 1)(rng) < p;
+    };
+    auto failing = [&](double p) {
+        return config.errors > 0 && chance(p);
+    };
+    string stream;
+    
+    // Random names, made unique by a numeric suffix
+    vector<string> names(config.teams);
+    for (int i = 0; i < config.teams; i++) {
+        int length = rng() % 12 + 1;
+        for (int c = 0; c < length; c++) names[i] += NAME_CHARS[rng() % 63];
+        names[i] += to_string(i);
+        stream += "ADDTEAM " + names[i] + "\n";
+        if (failing(config.errors)) stream += "ADDTEAM " + names[rng() % (i + 1)] + "\n";
+    }
+    
+    const int duration = 100000;
+    const string start = "START DURATION " + to_string(duration) + " PROBLEM " +
+                         to_string(config.problems) + "\n";
+    stream += start;
+    
+    // Names always end in a digit, so this one is never a team
+    const string missing = "missing_team";
+    bool frozen = false;
+    
+    int perRound = max(1, config.submissions / config.rounds);
+    for (int i = 0; i < config.submissions; i++) {
+        int offset = i % perRound;
+        if (config.freeze < 1 && offset == (int)(perRound * config.freeze)) {
+            stream += "FREEZE\n";
+            frozen = true;
+        }
+        
+        const string& team = names[rng() % config.teams];
+        char problem = 'A' + rng() % config.problems;
+        const char* status = chance(config.accept) ? STATUS_NAMES[ACCEPTED]
+                                                   : STATUS_NAMES[1 + rng() % 3];
+        int time = 1 + (int64_t)i * (duration - 1) / max(1, config.submissions);
+        stream += string("SUBMIT ") + problem + " BY " + team + " WITH " + status +
+                  " AT " + to_string(time) + "\n";
+        
+        if (chance(config.flush)) stream += "FLUSH\n";
+        if (chance(config.query)) {
+            const string& asked = names[rng() % config.teams];
+            if (rng() % 2) {
+                stream += "QUERY_RANKING " + asked + "\n";
+            } else {
+                stream += "QUERY_SUBMISSION " + asked + " WHERE PROBLEM=" +
+                          (rng() % 2 ? string("ALL") : string(1, 'A' + rng() % config.problems)) +
+                          " AND STATUS=" + (rng() % 2 ? "ALL" : STATUS_NAMES[rng() % 4]) + "\n";
+            }
+        }
+        
+        if (failing(config.errors)) {
+            switch (rng() % 5) {
+            case 0: stream += "ADDTEAM " + (rng() % 2 ? names[rng() % config.teams] : missing) + "\n"; break;
+            case 1: stream += start; break;
+            case 2: stream += frozen ? "FREEZE\n" : "SCROLL\n"; break;
+            case 3: stream += "QUERY_RANKING " + missing + "\n"; break;
+            default: stream += "QUERY_SUBMISSION " + missing + " WHERE PROBLEM=ALL AND STATUS=ALL\n"; break;
+            }
+        }
+        
+        if (config.freeze < 1 && (offset == perRound - 1 || i == config.submissions - 1)) {
+            stream += "SCROLL\n";
+            frozen = false;
+        }
+    }
+    stream += "END\n";
+    return stream;
+}
+
+#endif  // STREAM_GENERATOR_H
@@ -0,0 +1,259 @@
+#ifndef CONTEST_SERVER_H
+#define CONTEST_SERVER_H
+
+#include "icpc_system.h"
+
+#include <cctype>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. push and pop spin briefly, then sleep until the other
+// side makes progress, so an idle end costs no CPU; the lock is only
+// touched while one side is asleep.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+    static const int SPIN_LIMIT = 64;
+    T slots[CAPACITY];
+    alignas(64) atomic<size_t> head{0};  // Next slot to pop, advanced by the consumer
+    alignas(64) atomic<size_t> tail{0};  // Next slot to fill, advanced by the producer
+    alignas(64) atomic<int> sleepers{0};
+    mutex sleepLock;
+    condition_variable wake;
+    
+    // Both sides go through a read-modify-write of sleepers, which orders
+    // them: either the sleeper's ready() sees the other side's progress,
+    // or the other side sees the sleeper and wakes it
+    template <typename Ready>
+    void waitUntil(Ready ready) {
+        for (int spin = 0; spin < SPIN_LIMIT; spin++) {
+            if (ready()) return;
+            this_thread::yield();
+        }
+        unique_lock<mutex> lock(sleepLock);
+        sleepers.fetch_add(1);
+        while (!ready()) wake.wait(lock);
+        sleepers.fetch_sub(1);
+    }
+    
+    void wakeOther() {
+        if (sleepers.fetch_add(0) > 0) {
+            lock_guard<mutex> lock(sleepLock);
+            wake.notify_all();
+        }
+    }
+    
+public:
+    bool tryPush(const T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == CAPACITY) return false;
+        slots[t & (CAPACITY - 1)] = value;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+    
+    bool tryPop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        value = slots[h & (CAPACITY - 1)];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+    
+    void push(const T& value) {
+        waitUntil([&] { return tryPush(value); });
+        wakeOther();
+    }
+    
+    T pop() {
+        T value;
+        waitUntil([&] { return tryPop(value); });
+        wakeOther();
+        return value;
+    }
+};
+
+// Command lines bound for one worker, packed back to back as a Header
+// followed by the line text. An opening record carries the contest's
+// name instead of a command.
+struct CommandChunk {
+    static const size_t TARGET_SIZE = 1 << 16;
+    
+    struct Header {
+        uint32_t contest;
+        uint32_t length;
+        bool opens;
+    };
+    
+    vector<char> bytes;
+    
+    CommandChunk() {
+        bytes.reserve(TARGET_SIZE + 256);
+    }
+    
+    void append(uint32_t contest, bool opens, string_view text) {
+        Header header = {contest, (uint32_t)text.size(), opens};
+        size_t at = bytes.size();
+        bytes.resize(at + sizeof(header) + text.size());
+        memcpy(bytes.data() + at, &header, sizeof(header));
+        memcpy(bytes.data() + at + sizeof(header), text.data(), text.size());
+    }
+};
+
+// Owns every contest assigned to it; nothing is shared with other workers
+class ContestWorker {
+private:
+    struct Contest {
+        unique_ptr<FILE, int (*)(FILE*)> file;  // Closed after writer flushes
+        OutputWriter writer;
+        ICPCSystem system;
+        BatchingCommandRunner runner;
+        bool ended = false;
+        bool unflushed = false;  // Ran commands since the last flush
+        
+        // writer already buffers, so its flushes go straight to the file
+        Contest(FILE* file, bool deltaOutput)
+            : file(file, fclose), writer(file), system(writer), runner(system) {
+            setvbuf(file, nullptr, _IONBF, 0);
+            system.setDeltaOutput(deltaOutput);
+        }
+        
+        // Pending SUBMITs print nothing, so they can stay batched
+        void flush() {
+            writer.flush();
+            unflushed = false;
+        }
+        
+        ~Contest() {
+            runner.flushSubmits();
+        }
+    };
+    
+    string outDir;
+    bool deltaOutput;
+    unordered_map<uint32_t, unique_ptr<Contest>> contests;  // Null if the output failed to open
+    SpscQueue<CommandChunk*, 64> queue;  // A null chunk stops the worker
+    vector<Contest*> touched;  // Contests with commands in the current chunk
+    thread worker;
+    
+    // Output is flushed per chunk, so a live contest's answers go out as
+    // soon as its commands have been read
+    void process(const CommandChunk& chunk) {
+        const char* pos = chunk.bytes.data();
+        const char* end = pos + chunk.bytes.size();
+        while (pos < end) {
+            CommandChunk::Header header;
+            memcpy(&header, pos, sizeof(header));
+            string_view text(pos + sizeof(header), header.length);
+            pos += sizeof(header) + header.length;
+            
+            if (header.opens) {
+                string path = outDir + "/" + string(text) + ".out";
+                FILE* file = fopen(path.c_str(), "wb");
+                if (!file) fprintf(stderr, "cannot open %s\n", path.c_str());
+                contests[header.contest] = file ? make_unique<Contest>(file, deltaOutput) : nullptr;
+                continue;
+            }
+            Contest* contest = contests[header.contest].get();
+            if (!contest || contest->ended) continue;
+            if (!contest->unflushed) {
+                contest->unflushed = true;
+                touched.push_back(contest);
+            }
+            if (!contest->runner.run(text)) contest->ended = true;
+        }
+        for (Contest* contest : touched) contest->flush();
+        touched.clear();
+    }
+    
+    void run() {
+        while (true) {
+            CommandChunk* chunk = queue.pop();
+            if (!chunk) break;
+            process(*chunk);
+            delete chunk;
+        }
+        contests.clear();
+    }
+    
+public:
+    ContestWorker(string outDir, bool deltaOutput)
+        : outDir(move(outDir)), deltaOutput(deltaOutput), worker(&ContestWorker::run, this) {}
+    
+    void push(CommandChunk* chunk) {
+        queue.push(chunk);
+    }
+    
+    void join() {
+        push(nullptr);
+        worker.join();
+    }
+};
+
+// Contest names become file names, so keep them to a safe alphabet
+inline bool validContestName(string_view name) {
+    for (char c : name) {
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+    }
+    return !name.empty();
+}
+
+// Server mode: every input line is "<contest> <command>". A contest is
+// pinned to a worker thread the first time it appears, and its output
+// goes to outDir/<contest>.out. The reader thread only splits lines off
+// and hands them over in chunks, flushing partial chunks whenever the
+// next read could block, so live streams are not held back.
+inline void runContestServer(FILE* in, const string& outDir, int workerCount, bool deltaOutput) {
+    vector<unique_ptr<ContestWorker>> workers;
+    vector<CommandChunk*> pending;
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(make_unique<ContestWorker>(outDir, deltaOutput));
+        pending.push_back(new CommandChunk);
+    }
+    auto send = [&](int w) {
+        if (pending[w]->bytes.empty()) return;
+        workers[w]->push(pending[w]);
+        pending[w] = new CommandChunk;
+    };
+    
+    const uint32_t IGNORED = UINT32_MAX;
+    unordered_map<string, uint32_t> contestIds;
+    uint32_t contestCount = 0;
+    string name;
+    InputReader reader(in);
+    string_view line;
+    while (reader.nextLine(line)) {
+        string_view command = line;
+        name.assign(nextToken(command));
+        if (name.empty()) continue;
+        
+        auto found = contestIds.find(name);
+        if (found == contestIds.end()) {
+            bool valid = validContestName(name);
+            if (!valid) fprintf(stderr, "ignoring contest with invalid name %s\n", name.c_str());
+            found = contestIds.emplace(name, valid ? contestCount++ : IGNORED).first;
+            if (valid) pending[found->second % workerCount]->append(found->second, true, name);
+        }
+        uint32_t contest = found->second;
+        if (contest != IGNORED) {
+            int w = contest % workerCount;
+            pending[w]->append(contest, false, command);
+            if (pending[w]->bytes.size() >= CommandChunk::TARGET_SIZE) send(w);
+        }
+        if (!reader.lineBuffered()) {
+            for (int w = 0; w < workerCount; w++) send(w);
+        }
+    }
+    
+    for (int w = 0; w < workerCount; w++) {
+        send(w);
+        delete pending[w];
+        workers[w]->join();
+    }
+}
+
+#endif  // CONTEST_SERVER_H
@@ -0,0 +1,1554 @@
+#ifndef ICPC_SYSTEM_H
+#define ICPC_SYSTEM_H
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <algorithm>
+#include <queue>
+#include <charconv>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <sys/mman.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include <memory>
+#include <utility>
+
+#include "ranking_publisher.h"
+
+using namespace std;
+
+const int MAX_PROBLEMS = 26;
+const int ALL_PROBLEMS = MAX_PROBLEMS;  // QUERY_SUBMISSION wildcard
+
+// Flushes switch to worker threads from this many teams on. The default
+// is well above the judge's 10^4 limit, so contests there never start a
+// thread.
+#ifndef ICPC_PARALLEL_FLUSH_TEAMS
+#define ICPC_PARALLEL_FLUSH_TEAMS 65536
+#endif
+const size_t PARALLEL_FLUSH_TEAMS = ICPC_PARALLEL_FLUSH_TEAMS;
+
+// Opt-in hot-path counters, compiled in with -DICPC_INSTRUMENT (CMake
+// option ICPC_INSTRUMENT). ICPCSystem prints a summary to stderr on END.
+// Without the flag ICPC_TIME_PHASE and ICPC_STAT expand to nothing.
+#ifdef ICPC_INSTRUMENT
+struct PhaseCounter {
+    uint64_t calls = 0;
+    uint64_t cycles = 0;
+};
+
+inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Adds the cycles of the enclosing scope to a PhaseCounter
+class CycleTimer {
+private:
+    PhaseCounter& counter;
+    uint64_t start;
+    
+public:
+    explicit CycleTimer(PhaseCounter& counter) : counter(counter), start(readCycles()) {}
+    
+    ~CycleTimer() {
+        counter.calls++;
+        counter.cycles += readCycles() - start;
+    }
+};
+
+// Every RankKey comparison, from any thread
+inline atomic<uint64_t> keyCompares{0};
+
+struct Instrumentation {
+    PhaseCounter flush, scrollSearch, print, querySubmission;
+    uint64_t flushCompares = 0;     // Key comparisons made inside flushes
+    uint64_t maxFlushCompares = 0;
+    uint64_t scrollMoves = 0;       // Unfreezes that moved a team up
+    uint64_t scrollDistance = 0;    // Ranks gained over all of them
+    uint64_t maxScrollDistance = 0;
+    
+    void recordScrollMove(uint64_t distance) {
+        scrollMoves++;
+        scrollDistance += distance;
+        maxScrollDistance = max(maxScrollDistance, distance);
+    }
+    
+    void recordFlush(uint64_t compares) {
+        flushCompares += compares;
+        maxFlushCompares = max(maxFlushCompares, compares);
+    }
+    
+    void report(FILE* file) const {
+        fprintf(file, "[instrument] %-16s %10s %14s %12s\n", "phase", "calls", "cycles", "cycles/call");
+        auto row = [file](const char* name, const PhaseCounter& c) {
+            fprintf(file, "[instrument] %-16s %10llu %14llu %12.1f\n", name,
+                    (unsigned long long)c.calls, (unsigned long long)c.cycles,
+                    c.calls ? (double)c.cycles / c.calls : 0.0);
+        };
+        row("flushScoreboard", flush);
+        row("scrollSearch", scrollSearch);
+        row("printScoreboard", print);
+        row("querySubmission", querySubmission);
+        fprintf(file, "[instrument] key compares: %llu in flushes (%.1f per flush, max %llu), %llu total\n",
+                (unsigned long long)flushCompares,
+                flush.calls ? (double)flushCompares / flush.calls : 0.0,
+                (unsigned long long)maxFlushCompares, (unsigned long long)keyCompares.load());
+        fprintf(file, "[instrument] scroll moves: %llu, ranks gained %llu (%.1f per move, max %llu)\n",
+                (unsigned long long)scrollMoves, (unsigned long long)scrollDistance,
+                scrollMoves ? (double)scrollDistance / scrollMoves : 0.0,
+                (unsigned long long)maxScrollDistance);
+    }
+};
+
+#define ICPC_TIME_PHASE(counter) CycleTimer phaseTimer(stats.counter)
+#define ICPC_STAT(statement) statement
+#else
+#define ICPC_TIME_PHASE(counter)
+#define ICPC_STAT(statement)
+#endif
+
+enum JudgeStatus : uint8_t {
+    ACCEPTED,
+    WRONG_ANSWER,
+    RUNTIME_ERROR,
+    TIME_LIMIT_EXCEED,
+    STATUS_COUNT,
+    ALL_STATUSES = STATUS_COUNT  // QUERY_SUBMISSION wildcard
+};
+
+const char* const STATUS_NAMES[STATUS_COUNT] = {
+    "Accepted", "Wrong_Answer", "Runtime_Error", "Time_Limit_Exceed"
+};
+
+// Judge statuses differ in their first letter
+inline JudgeStatus parseStatus(string_view status) {
+    switch (status[0]) {
+    case 'A': return ACCEPTED;
+    case 'W': return WRONG_ANSWER;
+    case 'R': return RUNTIME_ERROR;
+    default: return TIME_LIMIT_EXCEED;
+    }
+}
+
+// Packed 8-byte record; time < 0 marks an empty entry
+struct Submission {
+    int time = -1;
+    uint8_t problem = 0;
+    JudgeStatus status = ACCEPTED;
+};
+
+// One SUBMIT for ICPCSystem::submitBatch, with the team already resolved
+struct SubmitRecord {
+    int team;
+    int time;
+    uint8_t problem;
+    JudgeStatus status;
+};
+
+// Per-problem state of one team; all teams' entries share one [N][problemCount] block
+struct ProblemStatus {
+    bool solved = false;
+    int solveTime = 0;
+    int wrongAttempts = 0;
+    int frozenSubmissions = 0;
+    // First frozen Accepted, valid while the team's frozenAcceptMask bit is
+    // set. Only it and the attempts before it matter when unfreezing.
+    int frozenAcceptTime = 0;
+    int frozenWrongBefore = 0;
+};
+
+// Latest submission matching each QUERY_SUBMISSION filter, indexed by
+// [problem or ALL_PROBLEMS][status or ALL_STATUSES]
+struct QueryTable {
+    Submission lastMatches[ALL_PROBLEMS + 1][ALL_STATUSES + 1];
+};
+
+// Fixed-size ranking key: a team that ranks higher has a smaller key.
+// Words are stored big-endian so that memcmp order equals ranking order:
+// [unsolved count, penalty, M solve times in descending order, name rank]
+// for a contest of M problems, zero-padded to MAX_PROBLEMS. Only the
+// first M + 3 words can differ, which is all less<M> looks at.
+struct RankKey {
+    static const int WORDS = MAX_PROBLEMS + 3;
+    uint32_t words[WORDS] = {};
+    
+    RankKey() {
+        words[0] = __builtin_bswap32(MAX_PROBLEMS);
+    }
+    
+    int solvedCount() const {
+        return MAX_PROBLEMS - __builtin_bswap32(words[0]);
+    }
+    
+    // Goes right after the contest's problemCount solve times
+    void setNameRank(int nameRank, int problemCount) {
+        words[2 + problemCount] = __builtin_bswap32(nameRank);
+    }
+    
+    // Count one more solved problem, inserting its time into the
+    // descending run of solve times. O(M), no re-sort.
+    void addSolve(int solveTime, int penaltyDelta) {
+        int pos = solvedCount();
+        words[0] = __builtin_bswap32(MAX_PROBLEMS - pos - 1);
+        words[1] = __builtin_bswap32(__builtin_bswap32(words[1]) + penaltyDelta);
+        while (pos > 0 && __builtin_bswap32(words[1 + pos]) < (uint32_t)solveTime) {
+            words[2 + pos] = words[1 + pos];
+            pos--;
+        }
+        words[2 + pos] = __builtin_bswap32(solveTime);
+    }
+    
+    // Order-preserving 64-bit summary: unsolved count, penalty and the
+    // latest solve time. Equal prefixes still need the full comparison.
+    uint64_t prefix() const {
+        uint64_t latest = min<uint32_t>(__builtin_bswap32(words[2]), (1u << 27) - 1);
+        return (uint64_t)__builtin_bswap32(words[0]) << 59
+             | (uint64_t)__builtin_bswap32(words[1]) << 27
+             | latest;
+    }
+    
+    bool operator<(const RankKey& other) const {
+        ICPC_STAT(keyCompares.fetch_add(1, memory_order_relaxed));
+        return memcmp(words, other.words, sizeof(words)) < 0;
+    }
+    
+    // Same order as operator< for keys of an M-problem contest. The word
+    // count is a constant, so the loop unrolls and makes no library call.
+    template <int M>
+    static bool less(const RankKey& a, const RankKey& b) {
+        ICPC_STAT(keyCompares.fetch_add(1, memory_order_relaxed));
+        for (int w = 0; w < M + 3; w++) {
+            if (a.words[w] != b.words[w]) {
+                return __builtin_bswap32(a.words[w]) < __builtin_bswap32(b.words[w]);
+            }
+        }
+        return false;
+    }
+};
+
+// Below this many items std::sort beats the radix passes
+const size_t RADIX_SORT_MIN = 256;
+
+// Sort indices into keys by key: LSD radix sort on RankKey::prefix with
+// 11-bit digits, skipping digits every item shares, then std::sort on
+// each run of equal prefixes. Linear in the item count apart from ties.
+// less orders two keys, e.g. RankKey::less<M>.
+template <typename Less>
+void sortByKey(vector<int>& items, const vector<RankKey>& keys, Less less) {
+    auto byKey = [&keys, less](int a, int b) { return less(keys[a], keys[b]); };
+    size_t n = items.size();
+    if (n < RADIX_SORT_MIN) {
+        sort(items.begin(), items.end(), byKey);
+        return;
+    }
+    
+    const int DIGIT_BITS = 11, DIGITS = 6, BUCKETS = 1 << DIGIT_BITS;
+    struct Entry { uint64_t prefix; int item; };
+    vector<Entry> entries(n), scratch(n);
+    vector<uint32_t> counts(DIGITS * BUCKETS, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t prefix = keys[items[i]].prefix();
+        entries[i] = {prefix, items[i]};
+        for (int d = 0; d < DIGITS; d++) {
+            counts[d * BUCKETS + (prefix >> (d * DIGIT_BITS) & (BUCKETS - 1))]++;
+        }
+    }
+    for (int d = 0; d < DIGITS; d++) {
+        uint32_t* count = &counts[d * BUCKETS];
+        int shift = d * DIGIT_BITS;
+        if (count[entries[0].prefix >> shift & (BUCKETS - 1)] == n) continue;
+        uint32_t offset = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            uint32_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (const Entry& e : entries) {
+            scratch[count[e.prefix >> shift & (BUCKETS - 1)]++] = e;
+        }
+        entries.swap(scratch);
+    }
+    
+    for (size_t i = 0, j; i < n; i = j) {
+        items[i] = entries[i].item;
+        for (j = i + 1; j < n && entries[j].prefix == entries[i].prefix; j++) {
+            items[j] = entries[j].item;
+        }
+        if (j - i > 1) sort(items.begin() + i, items.begin() + j, byKey);
+    }
+}
+
+// Fenwick tree over 0/1 slot occupancy: counts and k-th lookups in O(log n)
+class FenwickTree {
+private:
+    vector<int> tree;
+    int highBit = 1;
+    
+public:
+    void reset(int n) {
+        tree.assign(n + 1, 0);
+        highBit = 1;
+        while (highBit * 2 <= n) highBit *= 2;
+    }
+    
+    void add(int i, int delta) {
+        for (i++; i < (int)tree.size(); i += i & -i) tree[i] += delta;
+    }
+    
+    // Number of occupied slots in [0, i)
+    int countBelow(int i) const {
+        int sum = 0;
+        for (; i > 0; i -= i & -i) sum += tree[i];
+        return sum;
+    }
+    
+    // Slot holding the k-th (0-based) occupied entry
+    int findKth(int k) const {
+        int pos = 0;
+        for (int step = highBit; step > 0; step /= 2) {
+            if (pos + step < (int)tree.size() && tree[pos + step] <= k) {
+                pos += step;
+                k -= tree[pos];
+            }
+        }
+        return pos;
+    }
+};
+
+// Run body(0) .. body(tasks - 1), one thread each, task 0 on the caller
+template <typename Body>
+inline void runParallel(int tasks, Body body) {
+    vector<thread> workers;
+    for (int t = 1; t < tasks; t++) workers.emplace_back(body, t);
+    body(0);
+    for (thread& worker : workers) worker.join();
+}
+
+// Append the index of every non-zero entry of values[0, n) to out, in
+// order. AVX2 tests eight entries per step when the build targets it.
+inline void appendNonZero(const uint32_t* values, size_t n, vector<int>& out) {
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(values + i));
+        __m256i isZero = _mm256_cmpeq_epi32(block, zero);
+        uint32_t nonZero = ~_mm256_movemask_ps(_mm256_castsi256_ps(isZero)) & 0xff;
+        for (; nonZero; nonZero &= nonZero - 1) out.push_back(i + __builtin_ctz(nonZero));
+    }
+#endif
+    for (; i < n; i++) {
+        if (values[i]) out.push_back(i);
+    }
+}
+
+// Per-team scalar state. Names, problem state, ranking keys, query
+// tables and frozen masks are kept by ICPCSystem in flat arrays indexed
+// by team ID.
+struct Team {
+    uint32_t nameOffset = 0;  // Name lives in ICPCSystem::namePool
+    uint32_t nameLength = 0;
+    uint32_t frozenAcceptMask = 0;  // Bit j set if a frozen submission to j was Accepted
+    int solved = 0;           // Totals behind the team's RankKey
+    int penalty = 0;
+};
+
+// Hands out input lines as views into one buffer. A regular file is
+// mapped whole, so every line is a view straight into the mapping; pipes
+// are read in large blocks. A line stays valid until the next call to
+// nextLine.
+class InputReader {
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    FILE* in;
+    vector<char> buffer;
+    const char* data = nullptr;  // The mapped file, or buffer.data()
+    size_t mappedSize = 0;
+    size_t begin = 0;
+    size_t end = 0;
+    bool eof = false;
+    
+    bool mapInput() {
+        struct stat info;
+        int fd = fileno(in);
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) return false;
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, flags, fd, 0);
+        if (mapped == MAP_FAILED) return false;
+        data = (const char*)mapped;
+        mappedSize = end = info.st_size;
+        eof = true;
+        return true;
+    }
+    
+public:
+    explicit InputReader(FILE* in) : in(in) {
+        if (!mapInput()) {
+            buffer.resize(BUFFER_SIZE);
+            data = buffer.data();
+        }
+    }
+    
+    ~InputReader() {
+        if (mappedSize) munmap((void*)data, mappedSize);
+    }
+    
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+    
+    // True if nextLine can return without reading, i.e. without blocking
+    bool lineBuffered() const {
+        return eof || memchr(data + begin, '\n', end - begin);
+    }
+    
+    bool nextLine(string_view& line) {
+        while (true) {
+            const char* first = data + begin;
+            const char* newline = (const char*)memchr(first, '\n', end - begin);
+            if (newline || (eof && begin < end)) {
+                const char* last = newline ? newline : data + end;
+                begin = last - data + (newline ? 1 : 0);
+                if (last > first && last[-1] == '\r') last--;
+                line = string_view(first, last - first);
+                return true;
+            }
+            if (eof) return false;
+            
+            // Keep the partial line and refill behind it
+            memmove(buffer.data(), first, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+            // read, unlike fread, returns what a pipe holds without waiting
+            // for the whole buffer, so live input is never held back
+            ssize_t n;
+            do {
+                n = read(fileno(in), buffer.data() + end, buffer.size() - end);
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                eof = true;
+                n = 0;
+            }
+            end += n;
+            data = buffer.data();
+        }
+    }
+};
+
+// Pops the next space-separated token off the front of rest
+inline string_view nextToken(string_view& rest) {
+    size_t start = rest.find_first_not_of(' ');
+    if (start == string_view::npos) {
+        rest = string_view();
+        return rest;
+    }
+    size_t stop = rest.find(' ', start);
+    if (stop == string_view::npos) stop = rest.size();
+    string_view token = rest.substr(start, stop - start);
+    rest.remove_prefix(stop);
+    return token;
+}
+
+inline int parseInt(string_view token) {
+    int value = 0;
+    from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+// Collects output in one large buffer and writes it out only when the
+// buffer fills up or flush() is called. flush() also drains stdio, so
+// what was flushed has reached the file.
+class OutputWriter {
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    FILE* out;
+    vector<char> buffer;
+    size_t used = 0;
+    
+    char* reserve(size_t n) {
+        if (used + n > buffer.size()) flush();
+        return buffer.data() + used;
+    }
+    
+public:
+    explicit OutputWriter(FILE* out) : out(out), buffer(BUFFER_SIZE) {}
+    
+    ~OutputWriter() {
+        flush();
+    }
+    
+    void flush() {
+        if (used > 0) fwrite(buffer.data(), 1, used, out);
+        used = 0;
+        fflush(out);
+    }
+    
+    OutputWriter& operator<<(string_view text) {
+        if (text.size() > buffer.size()) {
+            flush();
+            fwrite(text.data(), 1, text.size(), out);
+            return *this;
+        }
+        memcpy(reserve(text.size()), text.data(), text.size());
+        used += text.size();
+        return *this;
+    }
+    
+    OutputWriter& operator<<(const char* text) {
+        return *this << string_view(text);
+    }
+    
+    OutputWriter& operator<<(char c) {
+        *reserve(1) = c;
+        used++;
+        return *this;
+    }
+    
+    OutputWriter& operator<<(int value) {
+        char* first = reserve(12);
+        used = to_chars(first, first + 12, value).ptr - buffer.data();
+        return *this;
+    }
+};
+
+// Snapshot files hold raw bytes: scalars as they are, vectors as a
+// 64-bit count followed by their elements. Only trivially copyable types
+// go in, and a snapshot is only read back by the same build.
+class SnapshotWriter {
+private:
+    FILE* file;
+    
+public:
+    explicit SnapshotWriter(FILE* file) : file(file) {}
+    
+    template <typename T>
+    void write(const T& value) {
+        static_assert(is_trivially_copyable_v<T>);
+        fwrite(&value, sizeof(T), 1, file);
+    }
+    
+    template <typename T>
+    void write(const vector<T>& values) {
+        static_assert(is_trivially_copyable_v<T>);
+        write<uint64_t>(values.size());
+        fwrite(values.data(), sizeof(T), values.size(), file);
+    }
+};
+
+// Reads back what SnapshotWriter wrote from one in-memory buffer. Any
+// short read sets ok to false and leaves the target unchanged.
+class SnapshotReader {
+private:
+    const char* pos;
+    const char* end;
+    
+public:
+    bool ok = true;
+    
+    SnapshotReader(const char* data, size_t size) : pos(data), end(data + size) {}
+    
+    template <typename T>
+    void read(T& value) {
+        static_assert(is_trivially_copyable_v<T>);
+        if (!ok || (size_t)(end - pos) < sizeof(T)) {
+            ok = false;
+            return;
+        }
+        memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+    }
+    
+    template <typename T>
+    void read(vector<T>& values) {
+        static_assert(is_trivially_copyable_v<T>);
+        uint64_t count = 0;
+        read(count);
+        if (!ok || count > (size_t)(end - pos) / sizeof(T)) {
+            ok = false;
+            return;
+        }
+        values.resize(count);
+        memcpy(values.data(), pos, count * sizeof(T));
+        pos += count * sizeof(T);
+    }
+};
+
+// Files of the first layout carried "ICPCSNP1" and no version. Bump
+// SNAPSHOT_VERSION whenever the set, order or layout of saved fields
+// changes. 2: name rank moved into the key, problemState stride is the
+// problem count. 3: frozen masks moved from Team into frozenMasks.
+const uint64_t SNAPSHOT_MAGIC = 0x50414e5343504349ull;  // "ICPCSNAP"
+const uint32_t SNAPSHOT_VERSION = 3;
+
+class ICPCSystem {
+private:
+    OutputWriter& out;
+    vector<Team> teams;                   // Indexed by dense team ID
+    vector<char> namePool;                // All team names, back to back
+    vector<int> nameSlots;                // Open-addressing hash of team IDs by name, -1 if empty
+    vector<ProblemStatus> problemState;   // [team ID * problemCount + problem], sized at START
+    vector<RankKey> keys;                 // Indexed by team ID, kept current on every solve
+    vector<QueryTable> queryTables;       // Indexed by team ID
+    vector<uint32_t> frozenMasks;         // Indexed by team ID, bit j set while problem j is frozen
+    bool started = false;
+    bool frozen = false;
+    int freezeTime = -1;
+    int durationTime = 0;
+    int problemCount = 0;
+    vector<int> ranking;   // Team IDs in scoreboard order
+    vector<int> teamRank;  // Indexed by team ID, for O(1) lookup
+    bool nameOrderPending = false;  // Teams were added since ranking was sorted by name
+    uint64_t rankingVersion = 0;    // Bumped whenever ranking, teamRank or frozen changes
+    vector<int> dirtyTeams;   // Teams whose key changed since the last flush
+    vector<char> isDirty;     // Indexed by team ID
+    vector<int> mergeBuffer;
+    vector<string> rowCache;  // Indexed by team ID, row text after the rank
+    vector<char> rowCached;   // Indexed by team ID, rowCache is current
+    
+    // Delta output: boards list only the rows whose text or rank changed
+    // since the team was last printed, and every line is tagged
+    bool deltaOutput = false;
+    vector<int> printedRank;  // Indexed by team ID, -1 if never printed
+    
+    unique_ptr<RankingPublisher> publisher;  // Null until rankingPublisher is called
+    uint64_t publishedVersion = UINT64_MAX;  // rankingVersion of the last publication
+    size_t parallelFlushTeams = PARALLEL_FLUSH_TEAMS;  // Team count from which flushes use threads
+    unsigned flushThreads = max(1u, thread::hardware_concurrency());
+#ifdef ICPC_INSTRUMENT
+    mutable Instrumentation stats;
+#endif
+    
+    // Scroll state: every key a team can reach while unfreezing gets a slot
+    // in sorted key order, so the live ranking is the set of occupied slots
+    FenwickTree slotTree;
+    vector<int> slotTeam;      // Slot -> team ID
+    vector<int> stageSlots;    // Slots of each team's key sequence, flattened
+    vector<int> stageBegin;    // Team ID -> its current entry in stageSlots
+    vector<int> teamSlot;      // Team ID -> currently occupied slot
+    
+    string_view teamName(int id) const {
+        return string_view(namePool.data() + teams[id].nameOffset, teams[id].nameLength);
+    }
+    
+    ProblemStatus* problemsOf(int id) {
+        return &problemState[(size_t)id * problemCount];
+    }
+    
+    const ProblemStatus* problemsOf(int id) const {
+        return &problemState[(size_t)id * problemCount];
+    }
+    
+    // Account for a newly solved problem in the team's totals and key
+    void addSolve(int id, int solveTime, int wrongAttempts) {
+        int penaltyDelta = solveTime + 20 * wrongAttempts;
+        teams[id].solved++;
+        teams[id].penalty += penaltyDelta;
+        keys[id].addSolve(solveTime, penaltyDelta);
+    }
+    
+    static size_t hashName(string_view name) {
+        size_t h = 14695981039346656037ull;
+        for (char c : name) h = (h ^ (unsigned char)c) * 1099511628211ull;
+        return h;
+    }
+    
+    // Slot where name is stored, or the empty slot where it would go
+    size_t findSlot(string_view name) const {
+        size_t mask = nameSlots.size() - 1;
+        size_t i = hashName(name) & mask;
+        while (nameSlots[i] >= 0 && teamName(nameSlots[i]) != name) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+    
+    int findTeam(string_view name) const {
+        if (nameSlots.empty()) return -1;
+        return nameSlots[findSlot(name)];
+    }
+    
+    // Keeps the table at most half full
+    void indexTeam(int id) {
+        if (teams.size() * 2 > nameSlots.size()) {
+            nameSlots.assign(max<size_t>(16, nameSlots.size() * 2), -1);
+            for (size_t other = 0; other < teams.size(); other++) {
+                nameSlots[findSlot(teamName(other))] = other;
+            }
+        } else {
+            nameSlots[findSlot(teamName(id))] = id;
+        }
+    }
+    
+    bool compareTeams(int id1, int id2) const {
+        return keys[id1] < keys[id2];
+    }
+    
+    template <int M>
+    bool compareTeams(int id1, int id2) const {
+        return RankKey::less<M>(keys[id1], keys[id2]);
+    }
+    
+    // Record that a team's standing changed since the last flush
+    void markDirty(int id) {
+        if (!isDirty[id]) {
+            isDirty[id] = true;
+            dirtyTeams.push_back(id);
+        }
+    }
+    
+    // Before the first flush teams rank by name. addTeam only appends, and
+    // the name order is sorted once on first use.
+    void sortByName() {
+        if (!nameOrderPending) return;
+        sort(ranking.begin(), ranking.end(), [this](int a, int b) {
+            return teamName(a) < teamName(b);
+        });
+        for (size_t i = 0; i < ranking.size(); i++) {
+            teamRank[ranking[i]] = i;
+        }
+        nameOrderPending = false;
+        rankingVersion++;
+    }
+    
+    // Teams outside the dirty set keep their keys, so the rest of the
+    // ranking is still sorted: pull the dirty teams out, sort them, and
+    // merge them back in. Costs O(N + K log K) for K changed teams, and
+    // O(1) when nothing changed since the last flush.
+    void flushScoreboard() {
+        ICPC_TIME_PHASE(flush);
+        sortByName();
+        if (dirtyTeams.empty()) return;
+        rankingVersion++;
+        ICPC_STAT(uint64_t comparesBefore = keyCompares.load());
+        if (ranking.size() >= parallelFlushTeams && flushThreads > 1) {
+            flushScoreboardParallel();
+        } else {
+            (this->*flushKernel)();
+        }
+        ICPC_STAT(stats.recordFlush(keyCompares.load() - comparesBefore));
+    }
+    
+    // Kernels built for each problem count; START picks the one for the
+    // contest, so their key comparisons know the word count at compile time
+    using FlushKernel = void (ICPCSystem::*)();
+    using SortKernel = void (*)(vector<int>&, const vector<RankKey>&);
+    FlushKernel flushKernel = &ICPCSystem::flushScoreboardSerial<MAX_PROBLEMS>;
+    SortKernel sortKernel = &sortKeys<MAX_PROBLEMS>;
+    
+    template <int M>
+    static void sortKeys(vector<int>& items, const vector<RankKey>& keys) {
+        sortByKey(items, keys, RankKey::less<M>);
+    }
+    
+    template <int... Ms>
+    void selectKernels(int problems, integer_sequence<int, Ms...>) {
+        static const FlushKernel flushKernels[] = {&ICPCSystem::flushScoreboardSerial<Ms>...};
+        static const SortKernel sortKernels[] = {&ICPCSystem::sortKeys<Ms>...};
+        flushKernel = flushKernels[problems];
+        sortKernel = sortKernels[problems];
+    }
+    
+    template <int M>
+    void flushScoreboardSerial() {
+        auto byKey = [this](int a, int b) { return compareTeams<M>(a, b); };
+        sortByKey(dirtyTeams, keys, RankKey::less<M>);
+        
+        ranking.erase(remove_if(ranking.begin(), ranking.end(),
+                                [this](int id) { return isDirty[id]; }),
+                      ranking.end());
+        mergeBuffer.resize(ranking.size() + dirtyTeams.size());
+        merge(ranking.begin(), ranking.end(), dirtyTeams.begin(), dirtyTeams.end(),
+              mergeBuffer.begin(), byKey);
+        ranking.swap(mergeBuffer);
+        
+        for (size_t i = 0; i < ranking.size(); i++) {
+            teamRank[ranking[i]] = i;
+        }
+        for (int id : dirtyTeams) {
+            isDirty[id] = false;
+        }
+        dirtyTeams.clear();
+    }
+    
+    // Same steps as flushScoreboardSerial, split across flushThreads. Keys are
+    // unique once the competition starts, so every split point is exact
+    // and the result matches the single-threaded merge.
+    void flushScoreboardParallel() {
+        auto byKey = [this](int a, int b) { return compareTeams(a, b); };
+        int tasks = flushThreads;
+        
+        // Sort the dirty batch in chunks, then merge the chunks pairwise
+        size_t dirtyCount = dirtyTeams.size();
+        vector<size_t> bounds(tasks + 1);
+        for (int t = 0; t <= tasks; t++) bounds[t] = dirtyCount * t / tasks;
+        runParallel(tasks, [&](int t) {
+            sort(dirtyTeams.begin() + bounds[t], dirtyTeams.begin() + bounds[t + 1], byKey);
+        });
+        for (int width = 1; width < tasks; width *= 2) {
+            int pairs = (tasks + 2 * width - 1) / (2 * width);
+            runParallel(pairs, [&](int p) {
+                int first = 2 * p * width;
+                int middle = min(first + width, tasks);
+                int last = min(first + 2 * width, tasks);
+                if (middle < last) {
+                    inplace_merge(dirtyTeams.begin() + bounds[first], dirtyTeams.begin() + bounds[middle],
+                                  dirtyTeams.begin() + bounds[last], byKey);
+                }
+            });
+        }
+        
+        ranking.erase(remove_if(ranking.begin(), ranking.end(),
+                                [this](int id) { return isDirty[id]; }),
+                      ranking.end());
+        
+        // Each task merges a slice of the clean ranking with the dirty teams
+        // that fall between its first entry and the next slice's
+        size_t cleanCount = ranking.size();
+        vector<size_t> cleanBounds(tasks + 1), dirtyBounds(tasks + 1);
+        for (int t = 0; t <= tasks; t++) {
+            cleanBounds[t] = cleanCount * t / tasks;
+            if (t == 0) {
+                dirtyBounds[t] = 0;
+            } else if (t == tasks) {
+                dirtyBounds[t] = dirtyCount;
+            } else if (cleanBounds[t] < cleanCount) {
+                dirtyBounds[t] = lower_bound(dirtyTeams.begin(), dirtyTeams.end(),
+                                             ranking[cleanBounds[t]], byKey) - dirtyTeams.begin();
+            } else {
+                dirtyBounds[t] = dirtyCount;
+            }
+        }
+        mergeBuffer.resize(cleanCount + dirtyCount);
+        runParallel(tasks, [&](int t) {
+            merge(ranking.begin() + cleanBounds[t], ranking.begin() + cleanBounds[t + 1],
+                  dirtyTeams.begin() + dirtyBounds[t], dirtyTeams.begin() + dirtyBounds[t + 1],
+                  mergeBuffer.begin() + cleanBounds[t] + dirtyBounds[t], byKey);
+        });
+        ranking.swap(mergeBuffer);
+        
+        size_t total = ranking.size();
+        runParallel(tasks, [&](int t) {
+            for (size_t i = total * t / tasks; i < total * (t + 1) / tasks; i++) {
+                teamRank[ranking[i]] = i;
+            }
+        });
+        for (int id : dirtyTeams) {
+            isDirty[id] = false;
+        }
+        dirtyTeams.clear();
+    }
+    
+    // A frozen problem with no Accepted submission never changes its team's
+    // key or rank, and its only effect is the wrong attempt count. Settle
+    // all of them in bulk so the unfreeze loop only sees problems that
+    // become solved.
+    void resolveWrongOnlyProblems(const vector<int>& frozenTeams) {
+        for (int id : frozenTeams) {
+            Team& team = teams[id];
+            ProblemStatus* problems = problemsOf(id);
+            invalidateRow(id);
+            for (uint32_t mask = frozenMasks[id] & ~team.frozenAcceptMask; mask; mask &= mask - 1) {
+                ProblemStatus& ps = problems[__builtin_ctz(mask)];
+                ps.wrongAttempts += ps.frozenSubmissions;
+                ps.frozenSubmissions = 0;
+            }
+            frozenMasks[id] = team.frozenAcceptMask;
+            team.frozenAcceptMask = 0;
+        }
+    }
+    
+    // Frozen submissions are known when scrolling starts, and a team always
+    // unfreezes its problems in index order, so the keys it passes through
+    // can be computed up front. Sorting all of them once turns every later
+    // rank change into a pair of Fenwick updates.
+    void buildScrollSlots() {
+        int n = teams.size();
+        vector<RankKey> stageKeys;
+        vector<int> keyTeam;
+        stageBegin.assign(n, 0);
+        
+        for (int id = 0; id < n; id++) {
+            stageBegin[id] = stageKeys.size();
+            stageKeys.push_back(keys[id]);
+            keyTeam.push_back(id);
+            
+            const ProblemStatus* problems = problemsOf(id);
+            RankKey key = keys[id];
+            for (uint32_t mask = frozenMasks[id]; mask; mask &= mask - 1) {
+                const ProblemStatus& ps = problems[__builtin_ctz(mask)];
+                int wrong = ps.wrongAttempts + ps.frozenWrongBefore;
+                key.addSolve(ps.frozenAcceptTime, ps.frozenAcceptTime + 20 * wrong);
+                stageKeys.push_back(key);
+                keyTeam.push_back(id);
+            }
+        }
+        
+        int slotCount = stageKeys.size();
+        vector<int> order(slotCount);
+        for (int i = 0; i < slotCount; i++) order[i] = i;
+        sortKernel(order, stageKeys);
+        
+        stageSlots.resize(slotCount);
+        slotTeam.resize(slotCount);
+        for (int slot = 0; slot < slotCount; slot++) {
+            stageSlots[order[slot]] = slot;
+            slotTeam[slot] = keyTeam[order[slot]];
+        }
+        
+        slotTree.reset(slotCount);
+        teamSlot.resize(n);
+        for (int id = 0; id < n; id++) {
+            teamSlot[id] = stageSlots[stageBegin[id]];
+            slotTree.add(teamSlot[id], 1);
+        }
+    }
+    
+    // Rebuild ranking and teamRank from the occupied scroll slots
+    void collectScrollRanking() {
+        rankingVersion++;
+        ranking.clear();
+        for (int slot = 0; slot < (int)slotTeam.size(); slot++) {
+            int id = slotTeam[slot];
+            if (teamSlot[id] == slot) {
+                teamRank[id] = ranking.size();
+                ranking.push_back(id);
+            }
+        }
+    }
+    
+    static char* formatInt(char* p, int value) {
+        return to_chars(p, p + 12, value).ptr;
+    }
+    
+    static char* formatProblem(char* p, const ProblemStatus& ps, bool isFrozen) {
+        if (isFrozen) {
+            if (ps.wrongAttempts == 0) {
+                *p++ = '0';
+            } else {
+                *p++ = '-';
+                p = formatInt(p, ps.wrongAttempts);
+            }
+            *p++ = '/';
+            p = formatInt(p, ps.frozenSubmissions);
+        } else if (ps.solved) {
+            *p++ = '+';
+            if (ps.wrongAttempts != 0) p = formatInt(p, ps.wrongAttempts);
+        } else {
+            if (ps.wrongAttempts == 0) {
+                *p++ = '.';
+            } else {
+                *p++ = '-';
+                p = formatInt(p, ps.wrongAttempts);
+            }
+        }
+        return p;
+    }
+    
+    // Record that a team's row text changed
+    void invalidateRow(int id) {
+        rowCached[id] = false;
+    }
+    
+    // Format everything in a row after the rank: " solved penalty cells\n".
+    // Returns true if the text differs from what was cached before.
+    bool cacheRow(int id) {
+        char row[16 + 24 * MAX_PROBLEMS];
+        char* p = row;
+        *p++ = ' ';
+        p = formatInt(p, teams[id].solved);
+        *p++ = ' ';
+        p = formatInt(p, teams[id].penalty);
+        
+        const ProblemStatus* problems = problemsOf(id);
+        uint32_t frozenMask = frozenMasks[id];
+        for (int i = 0; i < problemCount; i++) {
+            bool isFrozen = frozen && (frozenMask >> i & 1);
+            *p++ = ' ';
+            p = formatProblem(p, problems[i], isFrozen);
+        }
+        *p++ = '\n';
+        rowCached[id] = true;
+        string_view text(row, p - row);
+        if (rowCache[id] == text) return false;
+        rowCache[id].assign(text);
+        return true;
+    }
+    
+    // Only the rank is formatted per print; rows come from the cache
+    void printScoreboard() {
+        ICPC_TIME_PHASE(print);
+        if (deltaOutput) {
+            printScoreboardDelta();
+            return;
+        }
+        for (int id : ranking) {
+            if (!rowCached[id]) cacheRow(id);
+            out << teamName(id) << ' ' << teamRank[id] + 1 << rowCache[id];
+        }
+    }
+    
+    // "ROW <row>" for each changed row in ranking order, then
+    // "BOARD_END <changed rows>"
+    void printScoreboardDelta() {
+        int changedRows = 0;
+        for (int id : ranking) {
+            bool changed = !rowCached[id] && cacheRow(id);
+            int rank = teamRank[id] + 1;
+            if (!changed && printedRank[id] == rank) continue;
+            out << "ROW " << teamName(id) << ' ' << rank << rowCache[id];
+            printedRank[id] = rank;
+            changedRows++;
+        }
+        out << "BOARD_END " << changedRows << '\n';
+    }
+    
+    // Hand reader threads a copy of the ranks QUERY_RANKING would report
+    // Skipped when the ranking is unchanged, so a FLUSH with no new
+    // solves stays O(1)
+    void publishRanking() {
+        if (!publisher) return;
+        sortByName();
+        if (publishedVersion == rankingVersion) return;
+        publishedVersion = rankingVersion;
+        RankingSnapshot* snapshot = new RankingSnapshot;
+        snapshot->teamRank = teamRank;
+        snapshot->frozen = frozen;
+        publisher->publish(snapshot);
+    }
+    
+    // A snapshot's pieces must describe the same teams before anything
+    // indexes one by another; a file from another build or a damaged one
+    // fails here instead of being misread
+    bool snapshotConsistent() const {
+        size_t n = teams.size();
+        if (problemCount < 0 || problemCount > MAX_PROBLEMS) return false;
+        if (keys.size() != n || queryTables.size() != n || frozenMasks.size() != n ||
+            teamRank.size() != n || isDirty.size() != n || ranking.size() != n) {
+            return false;
+        }
+        if (problemState.size() != n * problemCount) return false;
+        if (!nameSlots.empty() && (nameSlots.size() & (nameSlots.size() - 1)) != 0) return false;
+        // At most half full, as indexTeam keeps it, so probes always end
+        size_t indexed = 0;
+        for (int id : nameSlots) {
+            if (id < -1 || id >= (int)n) return false;
+            indexed += id >= 0;
+        }
+        if (indexed != n || nameSlots.size() < 2 * n) return false;
+        for (const Team& team : teams) {
+            if (team.nameOffset > namePool.size() || team.nameLength > namePool.size() - team.nameOffset) {
+                return false;
+            }
+        }
+        for (size_t id = 0; id < n; id++) {
+            if (nameSlots[findSlot(teamName(id))] != (int)id) return false;
+        }
+        // teamRank maps each entry back to its position, so ranking is a
+        // permutation of the team IDs
+        for (size_t i = 0; i < n; i++) {
+            if (ranking[i] < 0 || ranking[i] >= (int)n || teamRank[ranking[i]] != (int)i) return false;
+        }
+        for (int id : dirtyTeams) {
+            if (id < 0 || id >= (int)n || !isDirty[id]) return false;
+        }
+        return true;
+    }
+    
+    // Record one submission in the team's problem state and query table.
+    // Returns true if it solved a problem, i.e. the team's key changed.
+    bool applySubmit(int id, int probIdx, JudgeStatus status, int time) {
+        Team& team = teams[id];
+        ProblemStatus& ps = problemsOf(id)[probIdx];
+        
+        Submission sub;
+        sub.time = time;
+        sub.problem = probIdx;
+        sub.status = status;
+        
+        // Submissions arrive in time order, so the newest one is the last
+        // match for every filter it satisfies
+        QueryTable& table = queryTables[id];
+        for (int p : {probIdx, ALL_PROBLEMS}) {
+            table.lastMatches[p][status] = sub;
+            table.lastMatches[p][ALL_STATUSES] = sub;
+        }
+        
+        if (ps.solved) return false;
+        invalidateRow(id);
+        if (frozen) {
+            uint32_t bit = 1u << probIdx;
+            if (status == ACCEPTED && !(team.frozenAcceptMask & bit)) {
+                team.frozenAcceptMask |= bit;
+                ps.frozenAcceptTime = time;
+                ps.frozenWrongBefore = ps.frozenSubmissions;
+            }
+            ps.frozenSubmissions++;
+            frozenMasks[id] |= bit;
+        } else if (status == ACCEPTED) {
+            ps.solved = true;
+            ps.solveTime = time;
+            addSolve(id, time, ps.wrongAttempts);
+            return true;
+        } else {
+            // Wrong attempts only count once the problem is solved,
+            // so the ranking key does not change
+            ps.wrongAttempts++;
+        }
+        return false;
+    }
+    
+public:
+    explicit ICPCSystem(OutputWriter& out) : out(out) {}
+    
+    void addTeam(string_view name) {
+        if (started) {
+            out << "[Error]Add failed: competition has started.\n";
+            return;
+        }
+        if (findTeam(name) >= 0) {
+            out << "[Error]Add failed: duplicated team name.\n";
+            return;
+        }
+        int id = teams.size();
+        Team team;
+        team.nameOffset = namePool.size();
+        team.nameLength = name.size();
+        namePool.insert(namePool.end(), name.begin(), name.end());
+        teams.push_back(team);
+        keys.resize(teams.size());
+        queryTables.resize(teams.size());
+        frozenMasks.push_back(0);
+        indexTeam(id);
+        ranking.push_back(id);
+        teamRank.push_back(id);
+        isDirty.push_back(false);
+        rowCache.emplace_back();
+        rowCached.push_back(false);
+        printedRank.push_back(-1);
+        nameOrderPending = true;
+        out << "[Info]Add successfully.\n";
+    }
+    
+    void startCompetition(int duration, int problems) {
+        if (started) {
+            out << "[Error]Start failed: competition has started.\n";
+            return;
+        }
+        started = true;
+        durationTime = duration;
+        problemCount = problems;
+        problemState.assign(teams.size() * problemCount, ProblemStatus());
+        selectKernels(problemCount, make_integer_sequence<int, MAX_PROBLEMS + 1>());
+        rowCached.assign(teams.size(), false);
+        // Before START the ranking is in lexicographic order of names
+        sortByName();
+        for (size_t i = 0; i < ranking.size(); i++) {
+            keys[ranking[i]].setNameRank(i, problemCount);
+        }
+        
+        publishRanking();
+        out << "[Info]Competition starts.\n";
+    }
+    
+    // Ranks are published here after every START, FLUSH, FREEZE and
+    // SCROLL, for threads other than the one driving the system to read
+    // wait-free. Available once the teams are in; teams added later are
+    // missing from snapshots until the next publication.
+    RankingPublisher& rankingPublisher() {
+        if (!publisher) {
+            publisher = make_unique<RankingPublisher>();
+            publishRanking();
+        }
+        return *publisher;
+    }
+    
+    // Switch scoreboard prints to deltas; see printScoreboardDelta
+    void setDeltaOutput(bool enabled) {
+        deltaOutput = enabled;
+    }
+    
+    // Override the build's parallel flush threshold and thread count, so
+    // the parallel path can be exercised on any board size or machine
+    void setParallelFlush(size_t minTeams, unsigned threads) {
+        parallelFlushTeams = minTeams;
+        flushThreads = max(1u, threads);
+    }
+    
+    // Dense ID of a team, -1 if there is none by that name
+    int teamId(string_view name) const {
+        return findTeam(name);
+    }
+    
+    void submit(int probIdx, string_view teamName, JudgeStatus status, int time) {
+        int id = findTeam(teamName);
+        if (applySubmit(id, probIdx, status, time)) markDirty(id);
+    }
+    
+    // Apply a burst of submissions. Teams only interact through the
+    // ranking, which changes at flush, so records are grouped by team
+    // (reordering the array, keeping each team's records in order) and
+    // every team's state is updated in one pass.
+    void submitBatch(SubmitRecord* records, size_t count) {
+        stable_sort(records, records + count, [](const SubmitRecord& a, const SubmitRecord& b) {
+            return a.team < b.team;
+        });
+        for (size_t i = 0; i < count;) {
+            int id = records[i].team;
+            bool solved = false;
+            for (; i < count && records[i].team == id; i++) {
+                solved |= applySubmit(id, records[i].problem, records[i].status, records[i].time);
+            }
+            if (solved) markDirty(id);
+        }
+    }
+    
+    void flush() {
+        flushScoreboard();
+        publishRanking();
+        out << "[Info]Flush scoreboard.\n";
+    }
+    
+    void freeze() {
+        if (frozen) {
+            out << "[Error]Freeze failed: scoreboard has been frozen.\n";
+            return;
+        }
+        frozen = true;
+        rankingVersion++;
+        publishRanking();
+        out << "[Info]Freeze scoreboard.\n";
+    }
+    
+    void scroll() {
+        if (!frozen) {
+            out << "[Error]Scroll failed: scoreboard has not been frozen.\n";
+            return;
+        }
+        
+        out << "[Info]Scroll scoreboard.\n";
+        
+        // Flush first
+        flushScoreboard();
+        printScoreboard();
+        
+        // Unfreeze process: always take the lowest-ranked team that still
+        // has frozen problems, i.e. the frozen team in the highest slot.
+        // After resolveWrongOnlyProblems every unfreeze solves a problem.
+        vector<int> frozenTeams;
+        appendNonZero(frozenMasks.data(), frozenMasks.size(), frozenTeams);
+        resolveWrongOnlyProblems(frozenTeams);
+        buildScrollSlots();
+        priority_queue<int> frozenSlots;
+        for (int id : frozenTeams) {
+            if (frozenMasks[id]) frozenSlots.push(teamSlot[id]);
+        }
+        
+        while (!frozenSlots.empty()) {
+            int targetTeam = slotTeam[frozenSlots.top()];
+            frozenSlots.pop();
+            
+            // Unfreeze the team's smallest frozen problem
+            Team& team = teams[targetTeam];
+            uint32_t& frozenMask = frozenMasks[targetTeam];
+            int probIdx = __builtin_ctz(frozenMask);
+            frozenMask &= frozenMask - 1;
+            ProblemStatus& ps = problemsOf(targetTeam)[probIdx];
+            
+            // Frozen submissions count up to the first Accepted
+            ps.solved = true;
+            ps.solveTime = ps.frozenAcceptTime;
+            ps.wrongAttempts += ps.frozenWrongBefore;
+            ps.frozenSubmissions = 0;
+            addSolve(targetTeam, ps.solveTime, ps.wrongAttempts);
+            invalidateRow(targetTeam);
+            
+            // The team's next key was already placed by buildScrollSlots
+            int oldSlot = teamSlot[targetTeam];
+            int newSlot = stageSlots[++stageBegin[targetTeam]];
+            int replaced = -1;
+            {
+                ICPC_TIME_PHASE(scrollSearch);
+                int oldRank = slotTree.countBelow(oldSlot);
+                int newRank = slotTree.countBelow(newSlot);
+                if (newRank < oldRank) {
+                    replaced = slotTeam[slotTree.findKth(newRank)];
+                    ICPC_STAT(stats.recordScrollMove(oldRank - newRank));
+                }
+                slotTree.add(oldSlot, -1);
+                slotTree.add(newSlot, 1);
+                teamSlot[targetTeam] = newSlot;
+            }
+            
+            if (replaced >= 0) {
+                if (deltaOutput) out << "RANK_CHANGE ";
+                out << teamName(targetTeam) << " " << teamName(replaced) << " "
+                     << team.solved << " " << team.penalty << "\n";
+            }
+            
+            if (frozenMask) frozenSlots.push(teamSlot[targetTeam]);
+        }
+        
+        collectScrollRanking();
+        frozen = false;
+        publishRanking();
+        printScoreboard();
+    }
+    
+    void queryRanking(string_view teamName) {
+        int id = findTeam(teamName);
+        if (id < 0) {
+            out << "[Error]Query ranking failed: cannot find the team.\n";
+            return;
+        }
+        sortByName();
+        
+        out << "[Info]Complete query ranking.\n";
+        if (frozen) {
+            out << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        }
+        
+        int rank = teamRank[id] + 1;
+        
+        out << teamName << " NOW AT RANKING " << rank << "\n";
+    }
+    
+    // probIdx and status may be the ALL_PROBLEMS / ALL_STATUSES wildcards
+    void querySubmission(string_view teamName, int probIdx, JudgeStatus status) {
+        ICPC_TIME_PHASE(querySubmission);
+        int id = findTeam(teamName);
+        if (id < 0) {
+            out << "[Error]Query submission failed: cannot find the team.\n";
+            return;
+        }
+        
+        out << "[Info]Complete query submission.\n";
+        
+        const Submission& lastMatch = queryTables[id].lastMatches[probIdx][status];
+        
+        if (lastMatch.time < 0) {
+            out << "Cannot find any submission.\n";
+        } else {
+            out << teamName << " " << char('A' + lastMatch.problem) << " "
+                 << STATUS_NAMES[lastMatch.status] << " " << lastMatch.time << "\n";
+        }
+    }
+    
+    // Write the whole contest state to path, replacing any older snapshot
+    // only once the new one is complete. commandCount is stored for the
+    // caller to resume its input from. Pending output is flushed first,
+    // so everything the snapshot covers has been written out.
+    bool saveSnapshot(const char* path, uint64_t commandCount) {
+        out.flush();
+        string tempPath = string(path) + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file) return false;
+        
+        SnapshotWriter writer(file);
+        writer.write(SNAPSHOT_MAGIC);
+        writer.write(SNAPSHOT_VERSION);
+        writer.write(commandCount);
+        writer.write(started);
+        writer.write(frozen);
+        writer.write(freezeTime);
+        writer.write(durationTime);
+        writer.write(problemCount);
+        writer.write(nameOrderPending);
+        writer.write(teams);
+        writer.write(namePool);
+        writer.write(nameSlots);
+        writer.write(problemState);
+        writer.write(keys);
+        writer.write(queryTables);
+        writer.write(frozenMasks);
+        writer.write(ranking);
+        writer.write(teamRank);
+        writer.write(dirtyTeams);
+        writer.write(isDirty);
+        
+        // On disk before it replaces the old snapshot, so a crash leaves
+        // one complete snapshot or the other
+        bool ok = fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+        return ok && rename(tempPath.c_str(), path) == 0;
+    }
+    
+    // Load a snapshot written by saveSnapshot into a freshly constructed
+    // system, reading the file in one go. On failure the system is left
+    // partly loaded and should be discarded.
+    bool loadSnapshot(const char* path, uint64_t& commandCount) {
+        FILE* file = fopen(path, "rb");
+        if (!file) return false;
+        vector<char> data;
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long size = ftell(file);
+            if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+                data.resize(size);
+                data.resize(fread(data.data(), 1, size, file));
+            }
+        }
+        fclose(file);
+        
+        SnapshotReader reader(data.data(), data.size());
+        uint64_t magic = 0;
+        reader.read(magic);
+        uint32_t version = 0;
+        reader.read(version);
+        if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) return false;
+        reader.read(commandCount);
+        reader.read(started);
+        reader.read(frozen);
+        reader.read(freezeTime);
+        reader.read(durationTime);
+        reader.read(problemCount);
+        reader.read(nameOrderPending);
+        reader.read(teams);
+        reader.read(namePool);
+        reader.read(nameSlots);
+        reader.read(problemState);
+        reader.read(keys);
+        reader.read(queryTables);
+        reader.read(frozenMasks);
+        reader.read(ranking);
+        reader.read(teamRank);
+        reader.read(dirtyTeams);
+        reader.read(isDirty);
+        if (!reader.ok || !snapshotConsistent()) return false;
+        
+        selectKernels(problemCount, make_integer_sequence<int, MAX_PROBLEMS + 1>());
+        // Rows are re-rendered on the next print
+        rowCache.assign(teams.size(), string());
+        rowCached.assign(teams.size(), false);
+        printedRank.assign(teams.size(), -1);
+        return true;
+    }
+    
+    void end() {
+        out << "[Info]Competition ends.\n";
+        out.flush();
+        ICPC_STAT(stats.report(stderr));
+    }
+};
+
+// Parse one input line and run it. Returns false once END has run.
+inline bool runCommand(ICPCSystem& system, string_view line) {
+    string_view cmd = nextToken(line);
+    if (cmd.empty()) return true;
+    
+    // Commands are told apart by their first one or two letters
+    switch (cmd[0]) {
+    case 'A':  // ADDTEAM
+        system.addTeam(nextToken(line));
+        break;
+    case 'S':
+        if (cmd[1] == 'U') {  // SUBMIT [problem] BY [team] WITH [status] AT [time]
+            string_view problemName = nextToken(line);
+            nextToken(line);
+            string_view teamName = nextToken(line);
+            nextToken(line);
+            string_view status = nextToken(line);
+            nextToken(line);
+            system.submit(problemName[0] - 'A', teamName, parseStatus(status),
+                          parseInt(nextToken(line)));
+        } else if (cmd[1] == 'T') {  // START DURATION [duration] PROBLEM [count]
+            nextToken(line);
+            int durationTime = parseInt(nextToken(line));
+            nextToken(line);
+            int problemCount = parseInt(nextToken(line));
+            system.startCompetition(durationTime, problemCount);
+        } else {  // SCROLL
+            system.scroll();
+        }
+        break;
+    case 'F':
+        if (cmd[1] == 'L') {  // FLUSH
+            system.flush();
+        } else {  // FREEZE
+            system.freeze();
+        }
+        break;
+    case 'Q':
+        if (cmd[6] == 'R') {  // QUERY_RANKING [team]
+            system.queryRanking(nextToken(line));
+        } else {  // QUERY_SUBMISSION [team] WHERE PROBLEM=[problem] AND STATUS=[status]
+            string_view teamName = nextToken(line);
+            nextToken(line);
+            string_view problem = nextToken(line).substr(8);
+            nextToken(line);
+            string_view status = nextToken(line).substr(7);
+            system.querySubmission(teamName,
+                                   problem == "ALL" ? ALL_PROBLEMS : problem[0] - 'A',
+                                   status == "ALL" ? ALL_STATUSES : parseStatus(status));
+        }
+        break;
+    case 'E':  // END
+        system.end();
+        return false;
+    }
+    return true;
+}
+
+// Runs commands like runCommand, but holds back runs of consecutive
+// SUBMITs and applies them through submitBatch. SUBMIT prints nothing,
+// so the output is unchanged. Call flushSubmits before looking at the
+// system from outside, e.g. to take a snapshot.
+class BatchingCommandRunner {
+private:
+    static const size_t MAX_BATCH = 512;
+    ICPCSystem& system;
+    vector<SubmitRecord> pending;
+    
+public:
+    explicit BatchingCommandRunner(ICPCSystem& system) : system(system) {
+        pending.reserve(MAX_BATCH);
+    }
+    
+    void flushSubmits() {
+        if (pending.empty()) return;
+        system.submitBatch(pending.data(), pending.size());
+        pending.clear();
+    }
+    
+    // Returns false once END has run
+    bool run(string_view line) {
+        string_view rest = line;
+        string_view cmd = nextToken(rest);
+        if (cmd.size() < 2 || cmd[0] != 'S' || cmd[1] != 'U') {
+            if (cmd.empty()) return true;
+            flushSubmits();
+            return runCommand(system, line);
+        }
+        
+        // SUBMIT [problem] BY [team] WITH [status] AT [time]
+        SubmitRecord record;
+        record.problem = nextToken(rest)[0] - 'A';
+        nextToken(rest);
+        record.team = system.teamId(nextToken(rest));
+        nextToken(rest);
+        record.status = parseStatus(nextToken(rest));
+        nextToken(rest);
+        record.time = parseInt(nextToken(rest));
+        pending.push_back(record);
+        if (pending.size() == MAX_BATCH) flushSubmits();
+        return true;
+    }
+};
+
+#endif  // ICPC_SYSTEM_H
@@ -1,444 +1,87 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <map>
-#include <set>
-#include <algorithm>
-#include <sstream>
+#include "icpc_system.h"
+#include "contest_server.h"
 
-using namespace std;
+#include <cstdlib>
 
-struct Submission {
-    string problem;
-    string status;
-    int time;
-};
-
-struct ProblemStatus {
-    bool solved = false;
-    int solveTime = 0;
-    int wrongAttempts = 0;
-    int frozenSubmissions = 0;
-    vector<Submission> submissions;
-    vector<Submission> frozenSubs;  // Submissions made during freeze
-};
-
-class Team {
-public:
-    string name;
-    vector<ProblemStatus> problems;
-    
-    // Cached values for performance
-    mutable int cachedSolved = -1;
-    mutable int cachedPenalty = -1;
-    mutable vector<int> cachedTimes;
-    mutable bool cacheValid = false;
-    
-    Team(string n, int problemCount) : name(n), problems(problemCount) {}
-    
-    void invalidateCache() const {
-        cacheValid = false;
-    }
-    
-    void updateCache() const {
-        if (cacheValid) return;
-        
-        cachedSolved = 0;
-        cachedPenalty = 0;
-        cachedTimes.clear();
-        
-        for (const auto& p : problems) {
-            if (p.solved) {
-                cachedSolved++;
-                cachedPenalty += p.solveTime + 20 * p.wrongAttempts;
-                cachedTimes.push_back(p.solveTime);
-            }
-        }
-        sort(cachedTimes.rbegin(), cachedTimes.rend());
-        cacheValid = true;
-    }
-    
-    int getSolvedCount() const {
-        updateCache();
-        return cachedSolved;
-    }
-    
-    int getPenaltyTime() const {
-        updateCache();
-        return cachedPenalty;
-    }
-    
-    const vector<int>& getSolveTimes() const {
-        updateCache();
-        return cachedTimes;
-    }
-};
-
-class ICPCSystem {
-private:
-    map<string, Team*> teams;
-    bool started = false;
-    bool frozen = false;
-    int freezeTime = -1;
-    int durationTime = 0;
-    int problemCount = 0;
-    vector<string> ranking;
-    map<string, int> teamRank;  // Cache team ranks for O(1) lookup
-    
-    bool compareTeams(const string& t1Name, const string& t2Name) {
-        Team* team1 = teams[t1Name];
-        Team* team2 = teams[t2Name];
-        
-        int solved1 = team1->getSolvedCount();
-        int solved2 = team2->getSolvedCount();
-        if (solved1 != solved2) return solved1 > solved2;
-        
-        int penalty1 = team1->getPenaltyTime();
-        int penalty2 = team2->getPenaltyTime();
-        if (penalty1 != penalty2) return penalty1 < penalty2;
-        
-        const vector<int>& times1 = team1->getSolveTimes();
-        const vector<int>& times2 = team2->getSolveTimes();
-        
-        size_t minSize = min(times1.size(), times2.size());
-        for (size_t i = 0; i < minSize; i++) {
-            if (times1[i] != times2[i]) return times1[i] < times2[i];
-        }
-        
-        return t1Name < t2Name;
-    }
-    
-    void flushScoreboard() {
-        ranking.clear();
-        teamRank.clear();
-        for (auto& p : teams) {
-            ranking.push_back(p.first);
-        }
-        sort(ranking.begin(), ranking.end(), [this](const string& a, const string& b) {
-            return compareTeams(a, b);
-        });
-        for (size_t i = 0; i < ranking.size(); i++) {
-            teamRank[ranking[i]] = i;
-        }
-    }
-    
-    string getProblemDisplay(const ProblemStatus& ps, bool isFrozen) {
-        if (isFrozen) {
-            if (ps.wrongAttempts == 0) {
-                return "0/" + to_string(ps.frozenSubmissions);
-            } else {
-                return "-" + to_string(ps.wrongAttempts) + "/" + to_string(ps.frozenSubmissions);
-            }
-        } else if (ps.solved) {
-            if (ps.wrongAttempts == 0) return "+";
-            return "+" + to_string(ps.wrongAttempts);
+// code [--delta] [--restore SNAPSHOT] [--snapshot SNAPSHOT] [--snapshot-every K] [LOG]
+//
+// Reads commands from LOG, or from stdin. With --snapshot the full state
+// is saved every K commands (default 100000). --restore loads a snapshot
+// and skips the input lines it already covers, so a restarted process
+// is fed the same log again.
+//
+// --delta replaces full scoreboards with the rows that changed since the
+// last print, as "ROW <row>" lines ending in "BOARD_END <count>". Scroll
+// rank changes become "RANK_CHANGE <line>". Other output is unchanged.
+//
+// --server OUTDIR [--workers N] hosts many contests at once: each input
+// line is "<contest> <command>", contests are spread over N worker
+// threads (default: one per core) and each writes OUTDIR/<contest>.out.
+// Snapshots are not taken in server mode.
+int main(int argc, char** argv) {
+    const char* logPath = nullptr;
+    const char* snapshotPath = nullptr;
+    const char* restorePath = nullptr;
+    uint64_t snapshotEvery = 100000;
+    bool deltaOutput = false;
+    const char* serverDir = nullptr;
+    int workerCount = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        string_view arg = argv[i];
+        if (arg == "--delta") {
+            deltaOutput = true;
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--snapshot-every" && i + 1 < argc) {
+            snapshotEvery = max<uint64_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--server" && i + 1 < argc) {
+            serverDir = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            workerCount = max(1, atoi(argv[++i]));
+        } else if (arg == "--restore" && i + 1 < argc) {
+            restorePath = argv[++i];
         } else {
-            if (ps.wrongAttempts == 0) return ".";
-            return "-" + to_string(ps.wrongAttempts);
+            logPath = argv[i];
         }
     }
     
-    void printScoreboard() {
-        for (const string& teamName : ranking) {
-            Team* team = teams[teamName];
-            int rank = teamRank[teamName] + 1;
-            
-            cout << teamName << " " << rank << " " 
-                 << team->getSolvedCount() << " " 
-                 << team->getPenaltyTime();
-            
-            for (int i = 0; i < problemCount; i++) {
-                const ProblemStatus& ps = team->problems[i];
-                bool isFrozen = frozen && !ps.solved && ps.frozenSubmissions > 0;
-                cout << " " << getProblemDisplay(ps, isFrozen);
-            }
-            cout << "\n";
-        }
+    FILE* in = stdin;
+    if (logPath && !(in = fopen(logPath, "rb"))) {
+        fprintf(stderr, "cannot open %s\n", logPath);
+        return 1;
     }
-    
-public:
-    void addTeam(const string& name) {
-        if (started) {
-            cout << "[Error]Add failed: competition has started.\n";
-            return;
-        }
-        if (teams.find(name) != teams.end()) {
-            cout << "[Error]Add failed: duplicated team name.\n";
-            return;
-        }
-        teams[name] = new Team(name, 26);  // Max 26 problems
-        ranking.push_back(name);
-        sort(ranking.begin(), ranking.end());
-        // Update teamRank
-        for (size_t i = 0; i < ranking.size(); i++) {
-            teamRank[ranking[i]] = i;
-        }
-        cout << "[Info]Add successfully.\n";
+    if (serverDir) {
+        runContestServer(in, serverDir, workerCount, deltaOutput);
+        return 0;
     }
     
-    void startCompetition(int duration, int problems) {
-        if (started) {
-            cout << "[Error]Start failed: competition has started.\n";
-            return;
-        }
-        started = true;
-        durationTime = duration;
-        problemCount = problems;
-        
-        cout << "[Info]Competition starts.\n";
-    }
+    OutputWriter writer(stdout);
+    ICPCSystem system(writer);
+    system.setDeltaOutput(deltaOutput);
+    InputReader reader(in);
+    BatchingCommandRunner runner(system);
+    string_view line;
     
-    void submit(const string& problem, const string& teamName, const string& status, int time) {
-        Team* team = teams[teamName];
-        int probIdx = problem[0] - 'A';
-        ProblemStatus& ps = team->problems[probIdx];
-        
-        Submission sub = {problem, status, time};
-        ps.submissions.push_back(sub);
-        
-        if (frozen && !ps.solved) {
-            ps.frozenSubmissions++;
-            ps.frozenSubs.push_back(sub);
-        } else if (!ps.solved) {
-            if (status == "Accepted") {
-                ps.solved = true;
-                ps.solveTime = time;
-                team->invalidateCache();
-            } else {
-                ps.wrongAttempts++;
-                team->invalidateCache();
-            }
+    uint64_t lineCount = 0;
+    if (restorePath) {
+        if (!system.loadSnapshot(restorePath, lineCount)) {
+            fprintf(stderr, "cannot restore snapshot %s\n", restorePath);
+            return 1;
         }
+        for (uint64_t i = 0; i < lineCount && reader.nextLine(line); i++) {}
     }
     
-    void flush() {
-        flushScoreboard();
-        cout << "[Info]Flush scoreboard.\n";
-    }
-    
-    void freeze() {
-        if (frozen) {
-            cout << "[Error]Freeze failed: scoreboard has been frozen.\n";
-            return;
-        }
-        frozen = true;
-        cout << "[Info]Freeze scoreboard.\n";
-    }
-    
-    void scroll() {
-        if (!frozen) {
-            cout << "[Error]Scroll failed: scoreboard has not been frozen.\n";
-            return;
-        }
-        
-        cout << "[Info]Scroll scoreboard.\n";
-        
-        // Flush first
-        flushScoreboard();
-        printScoreboard();
-        
-        // Unfreeze process
-        while (true) {
-            bool found = false;
-            string targetTeam;
-            char targetProblem = 'Z' + 1;
-            
-            // Find lowest-ranked team with frozen problems
-            for (int i = ranking.size() - 1; i >= 0; i--) {
-                Team* team = teams[ranking[i]];
-                int smallestFrozen = -1;
-                
-                for (int j = 0; j < problemCount; j++) {
-                    ProblemStatus& ps = team->problems[j];
-                    if (ps.frozenSubmissions > 0) {
-                        if (smallestFrozen == -1) smallestFrozen = j;
-                        break;
-                    }
-                }
-                
-                if (smallestFrozen != -1) {
-                    targetTeam = ranking[i];
-                    targetProblem = 'A' + smallestFrozen;
-                    found = true;
-                    break;
-                }
-            }
-            
-            if (!found) break;
-            
-            // Unfreeze the problem
-            Team* team = teams[targetTeam];
-            int probIdx = targetProblem - 'A';
-            ProblemStatus& ps = team->problems[probIdx];
-            
-            int oldRank = teamRank[targetTeam];
-            
-            // Process frozen submissions for this problem
-            bool changed = false;
-            for (const auto& sub : ps.frozenSubs) {
-                if (!ps.solved) {
-                    if (sub.status == "Accepted") {
-                        ps.solved = true;
-                        ps.solveTime = sub.time;
-                        changed = true;
-                    } else {
-                        ps.wrongAttempts++;
-                    }
-                }
-            }
-            ps.frozenSubmissions = 0;
-            ps.frozenSubs.clear();
-            
-            if (!changed) continue;  // No ranking change if not accepted
-            
-            team->invalidateCache();
-            
-            // Find new position by comparing with teams above
-            int newRank = oldRank;
-            while (newRank > 0 && compareTeams(targetTeam, ranking[newRank - 1])) {
-                newRank--;
-            }
-            
-            if (newRank < oldRank) {
-                // Remove from old position and insert at new position
-                ranking.erase(ranking.begin() + oldRank);
-                ranking.insert(ranking.begin() + newRank, targetTeam);
-                
-                // Update teamRank map for affected teams
-                for (int i = newRank; i <= oldRank; i++) {
-                    teamRank[ranking[i]] = i;
-                }
-                
-                cout << targetTeam << " " << ranking[newRank + 1] << " " 
-                     << team->getSolvedCount() << " " << team->getPenaltyTime() << "\n";
-            }
-        }
-        
-        frozen = false;
-        printScoreboard();
-    }
-    
-    void queryRanking(const string& teamName) {
-        if (teams.find(teamName) == teams.end()) {
-            cout << "[Error]Query ranking failed: cannot find the team.\n";
-            return;
-        }
-        
-        cout << "[Info]Complete query ranking.\n";
-        if (frozen) {
-            cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
-        }
-        
-        int rank = teamRank[teamName] + 1;
-        
-        cout << teamName << " NOW AT RANKING " << rank << "\n";
-    }
-    
-    void querySubmission(const string& teamName, const string& problem, const string& status) {
-        if (teams.find(teamName) == teams.end()) {
-            cout << "[Error]Query submission failed: cannot find the team.\n";
-            return;
-        }
-        
-        cout << "[Info]Complete query submission.\n";
-        
-        Team* team = teams[teamName];
-        Submission* lastMatch = nullptr;
-        
-        for (auto& p : team->problems) {
-            for (auto& sub : p.submissions) {
-                bool problemMatch = (problem == "ALL" || sub.problem == problem);
-                bool statusMatch = (status == "ALL" || sub.status == status);
-                
-                if (problemMatch && statusMatch) {
-                    if (!lastMatch || sub.time > lastMatch->time) {
-                        lastMatch = &sub;
-                    }
-                }
+    while (reader.nextLine(line)) {
+        if (!runner.run(line)) break;
+        lineCount++;
+        if (snapshotPath && lineCount % snapshotEvery == 0) {
+            runner.flushSubmits();
+            if (!system.saveSnapshot(snapshotPath, lineCount)) {
+                fprintf(stderr, "cannot write snapshot %s\n", snapshotPath);
             }
         }
-        
-        if (!lastMatch) {
-            cout << "Cannot find any submission.\n";
-        } else {
-            cout << teamName << " " << lastMatch->problem << " " 
-                 << lastMatch->status << " " << lastMatch->time << "\n";
-        }
-    }
-    
-    void end() {
-        cout << "[Info]Competition ends.\n";
-    }
-    
-    ~ICPCSystem() {
-        for (auto& p : teams) {
-            delete p.second;
-        }
-    }
-};
-
-int main() {
-    ios_base::sync_with_stdio(false);
-    cin.tie(nullptr);
-    
-    ICPCSystem system;
-    string line;
-    
-    while (getline(cin, line)) {
-        istringstream iss(line);
-        string cmd;
-        iss >> cmd;
-        
-        if (cmd == "ADDTEAM") {
-            string teamName;
-            iss >> teamName;
-            system.addTeam(teamName);
-        }
-        else if (cmd == "START") {
-            string duration, problem;
-            int durationTime, problemCount;
-            iss >> duration >> durationTime >> problem >> problemCount;
-            system.startCompetition(durationTime, problemCount);
-        }
-        else if (cmd == "SUBMIT") {
-            string problemName, by, teamName, with, status, at;
-            int time;
-            iss >> problemName >> by >> teamName >> with >> status >> at >> time;
-            system.submit(problemName, teamName, status, time);
-        }
-        else if (cmd == "FLUSH") {
-            system.flush();
-        }
-        else if (cmd == "FREEZE") {
-            system.freeze();
-        }
-        else if (cmd == "SCROLL") {
-            system.scroll();
-        }
-        else if (cmd == "QUERY_RANKING") {
-            string teamName;
-            iss >> teamName;
-            system.queryRanking(teamName);
-        }
-        else if (cmd == "QUERY_SUBMISSION") {
-            string teamName, where, rest;
-            iss >> teamName >> where;
-            getline(iss, rest);
-            
-            size_t problemPos = rest.find("PROBLEM=");
-            size_t statusPos = rest.find("STATUS=");
-            size_t andPos = rest.find(" AND ");
-            
-            string problem = rest.substr(problemPos + 8, andPos - (problemPos + 8));
-            string status = rest.substr(statusPos + 7);
-            
-            system.querySubmission(teamName, problem, status);
-        }
-        else if (cmd == "END") {
-            system.end();
-            break;
-        }
     }
+    runner.flushSubmits();
     
     return 0;
 }
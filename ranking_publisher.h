@@ -0,0 +1,150 @@
+#ifndef RANKING_PUBLISHER_H
+#define RANKING_PUBLISHER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Ranks as of the last flush or scroll, never modified once published
+struct RankingSnapshot {
+    vector<int> teamRank;  // Indexed by team ID, 0-based
+    bool frozen = false;
+};
+
+// Single-writer publication of RankingSnapshots to reader threads. The
+// writer swaps in a new snapshot with one atomic exchange. Readers load
+// the current pointer in a fixed number of steps, so reads are wait-free.
+// Old snapshots are freed by epoch: each reader announces the epoch it
+// started reading in, and a snapshot retired in epoch e is deleted once
+// no reader still announces an epoch <= e. Readers hold one of
+// MAX_READERS slots while they exist, so threads may come and go freely.
+class RankingPublisher {
+public:
+    static const int MAX_READERS = 64;
+    
+private:
+    static const uint64_t IDLE = UINT64_MAX;
+    
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch{IDLE};
+        atomic<bool> taken{false};
+    };
+    
+    struct Retired {
+        const RankingSnapshot* snapshot;
+        uint64_t epoch;
+    };
+    
+    atomic<const RankingSnapshot*> current{nullptr};
+    atomic<uint64_t> globalEpoch{0};
+    ReaderSlot slots[MAX_READERS];
+    vector<Retired> retired;  // Writer only
+    
+    // Free slots announce IDLE, so they never hold anything back
+    uint64_t oldestActiveEpoch() const {
+        uint64_t oldest = IDLE;
+        for (const ReaderSlot& slot : slots) oldest = min(oldest, slot.epoch.load());
+        return oldest;
+    }
+    
+public:
+    RankingPublisher() = default;
+    RankingPublisher(const RankingPublisher&) = delete;
+    RankingPublisher& operator=(const RankingPublisher&) = delete;
+    
+    // Readers must be gone by now
+    ~RankingPublisher() {
+        delete current.load();
+        for (const Retired& r : retired) delete r.snapshot;
+    }
+    
+    // Writer thread only. Takes ownership of snapshot.
+    void publish(const RankingSnapshot* snapshot) {
+        const RankingSnapshot* old = current.exchange(snapshot);
+        uint64_t epoch = globalEpoch.fetch_add(1);
+        if (old) retired.push_back({old, epoch});
+        
+        uint64_t oldest = oldestActiveEpoch();
+        size_t kept = 0;
+        for (const Retired& r : retired) {
+            if (oldest <= r.epoch) {
+                retired[kept++] = r;
+            } else {
+                delete r.snapshot;
+            }
+        }
+        retired.resize(kept);
+    }
+    
+    // One per reader thread, from registerReader. Gives its slot back
+    // when destroyed; must not outlive the publisher.
+    class Reader {
+    private:
+        RankingPublisher* publisher = nullptr;
+        ReaderSlot* slot = nullptr;  // Null if no slot was free, or moved from
+        
+    public:
+        Reader() = default;
+        Reader(RankingPublisher* publisher, ReaderSlot* slot) : publisher(publisher), slot(slot) {}
+        
+        Reader(Reader&& other) : publisher(other.publisher), slot(other.slot) {
+            other.slot = nullptr;
+        }
+        
+        Reader& operator=(Reader&& other) {
+            if (this != &other) {
+                release();
+                publisher = other.publisher;
+                slot = other.slot;
+                other.slot = nullptr;
+            }
+            return *this;
+        }
+        
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        
+        ~Reader() {
+            release();
+        }
+        
+        void release() {
+            if (slot) slot->taken.store(false);
+            slot = nullptr;
+        }
+        
+        explicit operator bool() const {
+            return slot != nullptr;
+        }
+        
+        // Run body on the current snapshot, which stays alive until it
+        // returns. Returns false if nothing has been published yet, or
+        // the reader holds no slot.
+        template <typename Body>
+        bool read(Body body) {
+            if (!slot) return false;
+            slot->epoch.store(publisher->globalEpoch.load());
+            const RankingSnapshot* snapshot = publisher->current.load();
+            if (snapshot) body(*snapshot);
+            slot->epoch.store(IDLE);
+            return snapshot != nullptr;
+        }
+    };
+    
+    // Any thread. Claims a free slot; the Reader is empty (false) if
+    // MAX_READERS readers are alive already.
+    Reader registerReader() {
+        for (ReaderSlot& slot : slots) {
+            bool expected = false;
+            if (!slot.taken.load() && slot.taken.compare_exchange_strong(expected, true)) {
+                return Reader(this, &slot);
+            }
+        }
+        return Reader();
+    }
+};
+
+#endif  // RANKING_PUBLISHER_H